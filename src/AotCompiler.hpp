@@ -0,0 +1,388 @@
+#pragma once
+#include <cstdio>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Expr.hpp"
+#include "Stmt.hpp"
+#include "interpreter.hpp"
+
+/**
+ * Ahead-of-time compiler. Translates a resolved program into a C++ source
+ * file that links against the loxrt runtime library (see AotRuntime.hpp).
+ * Every Lox function becomes a C++ function and every expression a sequence
+ * of statements over lox_literal temporaries, evaluated in Lox's left-to-right
+ * order. Resolved distances, operators and tokens are baked in as constants,
+ * so the built program does no tokenizing, parsing or resolving at startup.
+ */
+class AotCompiler : public ExprVisitorEval, public StmtVisitorEval {
+public:
+    AotCompiler() = default;
+
+    /** Translate a resolved program into a complete C++ translation unit. */
+    std::string compile(const std::vector<std::shared_ptr<Stmt>>& statements) {
+        beginFunction();
+        for (const auto& statement : statements) {
+            statement->accept(*this);
+        }
+        definitions << "static void lox_program(Interpreter& in) {\n" << endFunction() << "}\n\n";
+
+        std::ostringstream out;
+        out << "// Generated by 'interpreter compile'. Do not edit.\n";
+        out << "#include \"AotRuntime.hpp\"\n\n";
+        out << forwardDeclarations.str() << "\n";
+        out << constants.str() << "\n";
+        out << definitions.str();
+        out << "int main() {\n    return AotRuntime::run(lox_program);\n}\n";
+        return out.str();
+    }
+
+    lox_literal visit(const Literal& expr) override {
+        std::string value;
+        if (expr.value.isInt()) {
+            value = "lox_literal::integer(" + std::to_string(expr.value.asInt()) + ")";
+        } else if (expr.value.isNumber()) {
+            char buffer[64];
+            std::snprintf(buffer, sizeof buffer, "%a", expr.value.asNumber());
+            value = buffer;
+        } else if (expr.value.isString()) {
+            // One shared LoxString per literal for the life of the program, as in the interpreter
+            std::string text(expr.value.asString());
+            value = "str" + std::to_string(nextString++);
+            constants << "static const lox_literal " << value << "(std::string_view(" << cppStringLiteral(text)
+                      << ", " << text.size() << "));\n";
+        } else if (expr.value.isBool()) {
+            value = expr.value.asBool() ? "true" : "false";
+        } else {
+            value = "std::monostate{}";
+        }
+        exprResult = temp("lox_literal(" + value + ")");
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Grouping& expr) override {
+        exprResult = emit(*expr.expression);
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Variable& expr) override {
+        exprResult = emitLookup(expr.local, expr.name);
+        return std::monostate{};
+    }
+
+    lox_literal visit(const This& expr) override {
+        exprResult = emitLookup(expr.local, expr.keyword);
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Assign& expr) override {
+        std::string value = emit(*expr.value);
+        if (!expr.local.isGlobal()) {
+            line("AotRuntime::assignLocal(in, " + std::to_string(expr.local.depth) + ", " + std::to_string(expr.local.slot) + ", " + value + ");");
+        } else {
+            line("AotRuntime::assignGlobal(in, " + token(expr.name) + ", " + value + ");");
+        }
+        exprResult = value;
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Logical& expr) override {
+        std::string result = temp(emit(*expr.left));
+        bool isOr = expr.op.getTokenType() == TokenType::OR;
+        line(std::string("if (") + (isOr ? "!" : "") + "isTruthy(" + result + ")) {");
+        ++indent;
+        std::string right = emit(*expr.right);
+        line(result + " = " + right + ";");
+        --indent;
+        line("}");
+        exprResult = result;
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Binary& expr) override {
+        std::string left = emit(*expr.left);
+        std::string right = emit(*expr.right);
+        switch (expr.op.getTokenType()) {
+            case TokenType::EQUAL_EQUAL:
+                exprResult = temp("lox_literal(" + left + " == " + right + ")");
+                break;
+            case TokenType::BANG_EQUAL:
+                exprResult = temp("lox_literal(" + left + " != " + right + ")");
+                break;
+            default:
+                exprResult = temp("AotRuntime::binary<TokenType::" + expr.op.getStringType() + ">(" +
+                                  token(expr.op) + ", " + left + ", " + right + ")");
+        }
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Unary& expr) override {
+        std::string right = emit(*expr.right);
+        exprResult = temp("Interpreter::applyUnary(" + token(expr.op) + ", " + right + ")");
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Call& expr) override {
+        exprResult = temp(emitCall(expr, false));
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Get& expr) override {
+        std::string object = emit(*expr.object);
+        std::string cache = "cache" + std::to_string(nextCache++);
+        constants << "static GetCache " << cache << ";\n";
+        exprResult = temp("AotRuntime::getProperty(" + token(expr.name) + ", " + object + ", " + cache + ")");
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Set& expr) override {
+        std::string object = emit(*expr.object);
+        std::string instance = "i" + std::to_string(nextTemp++);
+        line("auto " + instance + " = AotRuntime::setTarget(" + token(expr.name) + ", " + object + ");");
+        std::string value = emit(*expr.value);
+        std::string cache = "cache" + std::to_string(nextCache++);
+        constants << "static SetCache " << cache << ";\n";
+        line(instance + "->set(" + token(expr.name) + ", " + value + ", " + cache + ");");
+        exprResult = value;
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Super& expr) override {
+        int distance = expr.local.depth;
+        exprResult = temp("AotRuntime::superMethod(in, " + std::to_string(distance) + ", " + token(expr.method) + ")");
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Expression& stmt) override {
+        emit(*stmt.expression);
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Print& stmt) override {
+        std::string value = emit(*stmt.expression);
+        line("std::cout << literal_to_string(" + value + ") << std::endl;");
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Var& stmt) override {
+        std::string value = stmt.initializer ? emit(*stmt.initializer) : "lox_literal()";
+        line("AotRuntime::define(in, " + token(stmt.name) + ", " + std::to_string(stmt.slot) + ", " + value + ");");
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Block& stmt) override {
+        line("{");
+        ++indent;
+        line("AotRuntime::Scope scope" + std::to_string(nextTemp++) + "(in, " + std::to_string(stmt.slotCount) + ", " +
+             (stmt.captured ? "true" : "false") + ");");
+        for (const auto& statement : stmt.statements) {
+            statement->accept(*this);
+        }
+        --indent;
+        line("}");
+        return std::monostate{};
+    }
+
+    lox_literal visit(const If& stmt) override {
+        std::string condition = emit(*stmt.condition);
+        line("if (isTruthy(" + condition + ")) {");
+        ++indent;
+        if (stmt.thenBranch) stmt.thenBranch->accept(*this);
+        --indent;
+        if (stmt.elseBranch) {
+            line("} else {");
+            ++indent;
+            stmt.elseBranch->accept(*this);
+            --indent;
+        }
+        line("}");
+        return std::monostate{};
+    }
+
+    lox_literal visit(const While& stmt) override {
+        line("while (true) {");
+        ++indent;
+        std::string condition = emit(*stmt.condition);
+        line("if (!isTruthy(" + condition + ")) break;");
+        stmt.body->accept(*this);
+        --indent;
+        line("}");
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Function& stmt) override {
+        int id = compileFunction(stmt);
+        line("AotRuntime::defineFunction(in, decl" + std::to_string(id) + ", body" + std::to_string(id) + ");");
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Return& stmt) override {
+        if (stmt.tailCall) {
+            line("return " + emitCall(static_cast<const Call&>(*stmt.value), true) + ";");
+            return std::monostate{};
+        }
+        std::string value = stmt.value ? emit(*stmt.value) : "lox_literal()";
+        line("return AotRuntime::returnWith(in, " + value + ");");
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Class& stmt) override {
+        std::string superclass = "s" + std::to_string(nextTemp++);
+        line("std::optional<lox_literal> " + superclass + ";");
+        if (stmt.superclass) {
+            line(superclass + " = " + emit(**stmt.superclass) + ";");
+        }
+        std::string declarations, bodies;
+        for (const auto& method : stmt.methods) {
+            int id = compileFunction(*method);
+            if (!declarations.empty()) {
+                declarations += ", ";
+                bodies += ", ";
+            }
+            declarations += "decl" + std::to_string(id);
+            bodies += "body" + std::to_string(id);
+        }
+        line("AotRuntime::defineClass(in, " + token(stmt.name) + ", " + std::to_string(stmt.slot) + ", " + superclass + ", {" + declarations + "}, {" + bodies + "});");
+        return std::monostate{};
+    }
+
+private:
+    /** Emit the statements evaluating an expression; returns the C++ expression naming its value. */
+    std::string emit(const Expr& expr) {
+        expr.accept(*this);
+        return exprResult;
+    }
+
+    std::string emitLookup(const LocalSlot& local, const Token& name) {
+        if (!local.isGlobal()) {
+            return temp("AotRuntime::getLocal(in, " + std::to_string(local.depth) + ", " + std::to_string(local.slot) + ")");
+        }
+        return temp("AotRuntime::getGlobal(in, " + token(name) + ")");
+    }
+
+    /** Emit the callee and arguments of a call; returns the C++ call, made as a tail call if `tail` is set. */
+    std::string emitCall(const Call& expr, bool tail) {
+        if (expr.method) {
+            std::string object = emit(*expr.method->object);
+            std::string cache = "cache" + std::to_string(nextCache++);
+            constants << "static GetCache " << cache << ";\n";
+            std::string callee = "m" + std::to_string(nextTemp++);
+            line("auto " + callee + " = AotRuntime::lookUpMethod(in, " + token(expr.method->name) + ", " + object + ", " + cache + ");");
+            std::string arguments;
+            for (const auto& argument : expr.arguments) {
+                if (!arguments.empty()) arguments += ", ";
+                arguments += emit(*argument);
+            }
+            std::string function = tail ? "AotRuntime::tailCallMethod" : "AotRuntime::callMethod";
+            return function + "(in, " + token(expr.paren) + ", " + callee + ", {" + arguments + "})";
+        }
+
+        std::string callee = emit(*expr.callee);
+        std::string arguments;
+        for (const auto& argument : expr.arguments) {
+            if (!arguments.empty()) arguments += ", ";
+            arguments += emit(*argument);
+        }
+        std::string function = tail ? "AotRuntime::tailCall" : "AotRuntime::call";
+        return function + "(in, " + token(expr.paren) + ", " + callee + ", {" + arguments + "})";
+    }
+
+    /** Emit a function's body as a C++ function plus its header and body constants. Returns its id. */
+    int compileFunction(const Function& function) {
+        int id = nextFunction++;
+        std::string name = "lox_fn" + std::to_string(id);
+        forwardDeclarations << "static Completion " << name << "(Interpreter& in);\n";
+
+        std::string params;
+        for (const auto& param : function.params) {
+            if (!params.empty()) params += ", ";
+            params += token(param);
+        }
+        std::string nameToken = token(function.name);
+        constants << "static const std::shared_ptr<Function> decl" << id
+                  << " = AotRuntime::declaration(" << nameToken << ", {" << params << "}, " << function.slot << ", "
+                  << function.slotCount << ", " << (function.bindsThis ? "true" : "false") << ", "
+                  << (function.captured ? "true" : "false") << ");\n";
+        constants << "static const std::shared_ptr<CompiledBody> body" << id
+                  << " = AotRuntime::body(" << name << ");\n";
+
+        // Body statements run directly in the call's environment, as in LoxFunction::call
+        beginFunction();
+        if (auto block = std::dynamic_pointer_cast<Block>(function.body)) {
+            for (const auto& statement : block->statements) {
+                statement->accept(*this);
+            }
+        } else {
+            function.body->accept(*this);
+        }
+        line("return Completion::NORMAL;");
+        definitions << "// " << function.name.getLexeme() << " (line " << function.name.getLine() << ")\n";
+        definitions << "static Completion " << name << "(Interpreter& in) {\n" << endFunction() << "}\n\n";
+        return id;
+    }
+
+    void beginFunction() {
+        bodies.emplace_back();
+        indents.push_back(indent);
+        indent = 1;
+    }
+
+    std::string endFunction() {
+        std::string body = bodies.back().str();
+        bodies.pop_back();
+        indent = indents.back();
+        indents.pop_back();
+        return body;
+    }
+
+    void line(const std::string& text) {
+        bodies.back() << std::string(4 * indent, ' ') << text << "\n";
+    }
+
+    /** Bind a value to a fresh temporary so later side effects cannot change it. */
+    std::string temp(const std::string& value) {
+        std::string name = "v" + std::to_string(nextTemp++);
+        line("lox_literal " + name + " = " + value + ";");
+        return name;
+    }
+
+    /** A file-scope Token constant for error reporting and operator dispatch. */
+    std::string token(const Token& token) {
+        std::string name = "t" + std::to_string(nextToken++);
+        constants << "static const Token " << name << "(TokenType::" << token.getStringType() << ", "
+                  << cppStringLiteral(token.getLexeme()) << ", std::monostate{}, " << token.getLine() << ");\n";
+        return name;
+    }
+
+    static std::string cppStringLiteral(std::string_view text) {
+        std::string out = "\"";
+        for (unsigned char c : text) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += static_cast<char>(c);
+            } else if (c < 0x20 || c >= 0x7F) {
+                // Octal escapes never swallow the characters that follow, unlike \x
+                char buffer[8];
+                std::snprintf(buffer, sizeof buffer, "\\%03o", c);
+                out += buffer;
+            } else {
+                out += static_cast<char>(c);
+            }
+        }
+        return out + "\"";
+    }
+
+    std::ostringstream forwardDeclarations;
+    std::ostringstream constants;
+    std::ostringstream definitions;
+    std::vector<std::ostringstream> bodies;
+    std::vector<int> indents;
+    std::string exprResult;
+    int indent = 0;
+    int nextTemp = 0;
+    int nextToken = 0;
+    int nextFunction = 0;
+    int nextString = 0;
+    int nextCache = 0;
+};
@@ -0,0 +1,175 @@
+#pragma once
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "interpreter.hpp"
+#include "LoxInstance.hpp"
+#include "CallStack.hpp"
+
+/**
+ * Runtime entry points for programs translated to C++ by the AotCompiler.
+ * Generated code runs on the Interpreter's runtime (environments, functions,
+ * classes and instances), so these helpers mirror what the ClosureCompiler's
+ * callables do and raise the same errors. They are linked from the loxrt
+ * library together with LoxClass, LoxInstance, LoxFunction and
+ * literal_to_string.
+ */
+class AotRuntime {
+public:
+    /** Makes the statements of a Lox block run in a fresh environment, restoring the outer one on exit. */
+    class Scope {
+    public:
+        Scope(Interpreter& in, size_t slotCount, bool captured)
+            : in(in), previous(in.environment), captured(captured) {
+            in.collectGarbageIfNeeded();
+            in.environment = captured ? makeRef<Environment>(previous, slotCount)
+                                      : in.acquireFrame(previous, slotCount);
+        }
+        ~Scope() {
+            Ref<Environment> frame = std::move(in.environment);
+            in.environment = std::move(previous);
+            if (!captured) in.releaseFrame(std::move(frame));
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Interpreter& in;
+        Ref<Environment> previous;
+        bool captured;
+    };
+
+    /** Function header (name, parameters and scope layout) for a LoxFunction whose body is compiled C++. */
+    static std::shared_ptr<Function> declaration(const Token& name, std::vector<Token> params, int slot, int slotCount, bool bindsThis, bool captured) {
+        auto function = Heap::make<Function>(name, std::move(params), nullptr);
+        function->slot = slot;
+        function->slotCount = slotCount;
+        function->bindsThis = bindsThis;
+        function->captured = captured;
+        return function;
+    }
+
+    static std::shared_ptr<CompiledBody> body(Completion (*function)(Interpreter&)) {
+        auto compiled = std::make_shared<CompiledBody>();
+        compiled->statements.push_back(function);
+        return compiled;
+    }
+
+    static lox_literal getLocal(Interpreter& in, int distance, int slot) {
+        return in.environment->getAt(distance, slot);
+    }
+
+    static lox_literal getGlobal(Interpreter& in, const Token& name) {
+        return in.globals->getValue(name);
+    }
+
+    static void assignLocal(Interpreter& in, int distance, int slot, const lox_literal& value) {
+        in.environment->assignAt(distance, slot, value);
+    }
+
+    static void assignGlobal(Interpreter& in, const Token& name, const lox_literal& value) {
+        in.globals->assign(name, value);
+    }
+
+    static void define(Interpreter& in, const Token& name, int slot, const lox_literal& value) {
+        in.defineVariable(name, slot, value);
+    }
+
+    /** Arithmetic and comparison with a fast path for two numbers; everything else goes through the Interpreter. */
+    template <TokenType Op>
+    static lox_literal binary(const Token& op, const lox_literal& left, const lox_literal& right) {
+        if (left.isNumber() && right.isNumber()) {
+            if constexpr (Op == TokenType::PLUS) return Value::add(left, right);
+            else if constexpr (Op == TokenType::MINUS) return Value::subtract(left, right);
+            else if constexpr (Op == TokenType::STAR) return Value::multiply(left, right);
+            else if constexpr (Op == TokenType::SLASH) return Value::divide(left, right);
+            else if constexpr (Op == TokenType::GREATER) return left.asNumber() > right.asNumber();
+            else if constexpr (Op == TokenType::GREATER_EQUAL) return left.asNumber() >= right.asNumber();
+            else if constexpr (Op == TokenType::LESS) return left.asNumber() < right.asNumber();
+            else if constexpr (Op == TokenType::LESS_EQUAL) return left.asNumber() <= right.asNumber();
+        }
+        return Interpreter::applyBinary(op, left, right);
+    }
+
+    static lox_literal call(Interpreter& in, const Token& paren, const lox_literal& callee, const std::vector<lox_literal>& arguments) {
+        return in.callValue(paren, callee, arguments);
+    }
+
+    /** 'return f(...)' leaves a Lox function for the caller to run in place of the returning call. */
+    static Completion tailCall(Interpreter& in, const Token& paren, const lox_literal& callee, std::vector<lox_literal> arguments) {
+        return in.tailCallValue(paren, callee, std::move(arguments));
+    }
+
+    /** obj.name(...) is looked up before its arguments are evaluated, then called without binding. */
+    static Interpreter::MethodCallee lookUpMethod(Interpreter& in, const Token& name, const lox_literal& object, GetCache& cache) {
+        return in.lookUpMethod(name, object, cache);
+    }
+
+    static lox_literal callMethod(Interpreter& in, const Token& paren, const Interpreter::MethodCallee& callee, const std::vector<lox_literal>& arguments) {
+        return in.callMethod(paren, callee, arguments);
+    }
+
+    static Completion tailCallMethod(Interpreter& in, const Token& paren, const Interpreter::MethodCallee& callee, std::vector<lox_literal> arguments) {
+        return in.tailCallMethod(paren, callee, std::move(arguments));
+    }
+
+    static lox_literal getProperty(const Token& name, const lox_literal& object, GetCache& cache) {
+        if (!object.isInstance()) {
+            throw RuntimeError(name, "Only instances have properties.");
+        }
+        return object.asInstance()->get(name, cache);
+    }
+
+    /** The receiver of a property assignment, checked before the value is evaluated. */
+    static Ref<LoxInstance> setTarget(const Token& name, const lox_literal& object) {
+        if (!object.isInstance()) {
+            throw RuntimeError(name, "Only instances have fields.");
+        }
+        return Ref<LoxInstance>(object.asInstance());
+    }
+
+    /** A 'return' statement: compiled function bodies return the result straight away. */
+    static Completion returnWith(Interpreter& in, const lox_literal& value) {
+        return in.returnWith(value);
+    }
+
+    static lox_literal superMethod(Interpreter& in, int distance, const Token& method) {
+        return in.superMethod(distance, method);
+    }
+
+    static void defineFunction(Interpreter& in, const std::shared_ptr<Function>& declaration, const std::shared_ptr<CompiledBody>& body) {
+        auto function = makeRef<LoxFunction>(declaration, in.environment, false);
+        function->setCompiledBody(body);
+        in.defineVariable(declaration->name, declaration->slot, function);
+    }
+
+    static void defineClass(Interpreter& in, const Token& name, int slot, const std::optional<lox_literal>& superclass,
+                            const std::vector<std::shared_ptr<Function>>& methods,
+                            const std::vector<std::shared_ptr<CompiledBody>>& bodies) {
+        in.createClass(name, slot, superclass, methods, &bodies);
+    }
+
+    /** Run a compiled program, reporting errors and exit codes the way 'run' does, with the same room for calls. */
+    static int run(void (*program)(Interpreter&)) {
+        std::cout << std::unitbuf;
+        std::cerr << std::unitbuf;
+        return CallStack::run(CallStack::DEFAULT_MAX_DEPTH, [program]() -> int {
+            try {
+                Interpreter interpreter;
+                // Function bodies are already native; the JIT only knows how to compile AST bodies
+                interpreter.setJitEnabled(false);
+                program(interpreter);
+            } catch (const RuntimeError& e) {
+                std::cerr << e.what() << "\n";
+                std::cerr << e.token.getLine() << std::endl;
+                return 70;
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << std::endl;
+                return 65;
+            }
+            return 0;
+        });
+    }
+};
@@ -0,0 +1,53 @@
+#include "CallStack.hpp"
+#include <exception>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+thread_local const char* CallStack::limit = nullptr;
+
+namespace {
+
+struct Task {
+    const std::function<int()>& body;
+    const char* limit;
+    int result = 0;
+    std::exception_ptr error;
+};
+
+} // namespace
+
+int CallStack::run(size_t maxDepth, const std::function<int()>& body) {
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t size = (maxDepth * BYTES_PER_CALL + RESERVE + page - 1) / page * page;
+    // The lowest page stays unmapped, so even a frame bigger than RESERVE faults instead of corrupting the heap
+    void* memory = mmap(nullptr, size + page, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (memory == MAP_FAILED) return body();
+    char* bottom = static_cast<char*>(memory);
+    mprotect(bottom, page, PROT_NONE);
+
+    Task task{body, bottom + page + RESERVE};
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstack(&attributes, bottom + page, size);
+    pthread_t thread;
+    auto entry = [](void* argument) -> void* {
+        Task& task = *static_cast<Task*>(argument);
+        limit = task.limit;
+        try {
+            task.result = task.body();
+        } catch (...) {
+            task.error = std::current_exception();
+        }
+        return nullptr;
+    };
+    bool started = pthread_create(&thread, &attributes, entry, &task) == 0;
+    pthread_attr_destroy(&attributes);
+    if (started) pthread_join(thread, nullptr);
+    munmap(memory, size + page);
+    if (!started) return body();
+
+    if (task.error) std::rethrow_exception(task.error);
+    return task.result;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+
+/**
+ * The machine stack Lox calls run on. A call in the tree-walking engines
+ * nests several C++ frames of the evaluator, so a thread's usual few
+ * megabytes run out a few thousand calls deep. CallStack::run runs a
+ * program on a stack mapped from the heap instead, reserved for the maximum
+ * call depth: memory is only committed for the pages deep recursion
+ * actually reaches. The interpreter counts calls against that depth and
+ * also checks exhausted(), so running out is a "Stack overflow." runtime
+ * error rather than a crash.
+ */
+class CallStack {
+public:
+    /**
+     * How deep calls may nest unless 'run --max-depth=N' says otherwise.
+     * Unwinding from an overflow takes time in proportion to the depth.
+     */
+    static constexpr size_t DEFAULT_MAX_DEPTH = 1 << 16;
+
+    /** The deepest a program may ask for, so the stack to reserve stays within the address space. */
+    static constexpr size_t MAX_DEPTH = 1 << 24;
+
+    /** Machine stack reserved per call, a few times what a tree-walked call takes. */
+    static constexpr size_t BYTES_PER_CALL = 4096;
+
+    /**
+     * Run body on a fresh stack with room for maxDepth calls, on a thread
+     * of its own that this one waits for, and return its result. Anything
+     * body throws is rethrown here. If no stack can be mapped, body runs on
+     * the current one.
+     */
+    static int run(size_t maxDepth, const std::function<int()>& body);
+
+    /** True if the current stack is too close to its end for another call. */
+    static bool exhausted() {
+        return static_cast<const char*>(__builtin_frame_address(0)) < limit;
+    }
+
+private:
+    /** Room left below the deepest call for its own frames, errors and collections. */
+    static constexpr size_t RESERVE = 256 * 1024;
+
+    /** Lowest address calls may reach on this thread's stack; null off a CallStack. */
+    static thread_local const char* limit;
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "VMValue.hpp"
+
+/**
+ * Bytecode instructions. Operands follow the opcode in the code stream:
+ * constant, variable and property indices are 16-bit, jump offsets are
+ * 32-bit and argument counts are a single byte (the parser caps them at 255).
+ */
+enum class OpCode : uint8_t {
+    CONSTANT,       // u16 constant
+    NIL,
+    TRUE,
+    FALSE,
+    POP,
+    POPN,           // u16 count
+    GET_LOCAL,      // u16 slot
+    SET_LOCAL,      // u16 slot
+    GET_GLOBAL,     // u16 global index
+    DEFINE_GLOBAL,  // u16 global index
+    SET_GLOBAL,     // u16 global index
+    GET_UPVALUE,    // u16 upvalue index
+    SET_UPVALUE,    // u16 upvalue index
+    GET_PROPERTY,   // u16 name constant
+    SET_PROPERTY,   // u16 name constant
+    CHECK_INSTANCE, // Fails early for 'obj.field = value' on non-instances
+    GET_METHOD,     // u16 name constant; pushes [callable, receiver-or-undefined]
+    GET_SUPER,      // u16 name constant
+    SUPER_METHOD,   // u16 name constant; like GET_METHOD for 'super.name(...)'
+    EQUAL,
+    NOT_EQUAL,
+    GREATER,
+    GREATER_EQUAL,
+    LESS,
+    LESS_EQUAL,
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    NOT,
+    NEGATE,
+    PRINT,
+    JUMP,           // u32 forward offset
+    JUMP_IF_FALSE,  // u32 forward offset, leaves the condition on the stack
+    LOOP,           // u32 backward offset
+    CALL,           // u8 argument count
+    CALL_METHOD,    // u8 argument count, after GET_METHOD or SUPER_METHOD
+    CLOSURE,        // u16 function constant, then (u8 isLocal, u16 index) per upvalue
+    CLOSE_UPVALUE,
+    RETURN,
+    CLASS,          // u16 name constant
+    INHERIT,
+    METHOD          // u16 name constant
+};
+
+/** A compiled function body: bytecode, the source line of every byte, and its constant pool. */
+class Chunk {
+public:
+    void write(uint8_t byte, int line) {
+        code.push_back(byte);
+        lines.push_back(line);
+    }
+
+    size_t addConstant(VMValue value) {
+        constants.push_back(value);
+        return constants.size() - 1;
+    }
+
+    std::vector<uint8_t> code;
+    std::vector<int> lines;
+    std::vector<VMValue> constants;
+};
@@ -0,0 +1,430 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "Expr.hpp"
+#include "Stmt.hpp"
+#include "CompiledCode.hpp"
+#include "interpreter.hpp"
+
+/**
+ * Closure-compilation backend. After the Resolver has run, each Expr/Stmt
+ * node is converted once into a C++ callable with its operator, resolved
+ * slot and child callables captured up front. Running the result skips
+ * the virtual accept dispatch and the operator switch in visit(Binary). The compiled code
+ * runs on the Interpreter's runtime (environments, functions, classes) and
+ * shares its operator and call helpers, so behaviour and error messages
+ * match the tree-walker exactly.
+ */
+class ClosureCompiler : public ExprVisitorEval, public StmtVisitorEval {
+public:
+    ClosureCompiler() = default;
+
+    /** Compile a resolved program into top-level statements to run in order. */
+    std::vector<CompiledStmt> compile(const std::vector<std::shared_ptr<Stmt>>& statements) {
+        std::vector<CompiledStmt> program;
+        program.reserve(statements.size());
+        for (const auto& statement : statements) {
+            program.push_back(compile(*statement));
+        }
+        return program;
+    }
+
+    lox_literal visit(const Literal& expr) override {
+        lox_literal value = expr.value;
+        exprResult = [value](Interpreter&) { return value; };
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Grouping& expr) override {
+        exprResult = compile(*expr.expression);
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Variable& expr) override {
+        exprResult = compileLookup(expr.local, expr.name);
+        return std::monostate{};
+    }
+
+    lox_literal visit(const This& expr) override {
+        exprResult = compileLookup(expr.local, expr.keyword);
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Assign& expr) override {
+        CompiledExpr value = compile(*expr.value);
+        Token name = expr.name;
+        if (!expr.local.isGlobal()) {
+            LocalSlot local = expr.local;
+            exprResult = [value, local](Interpreter& in) {
+                lox_literal result = value(in);
+                in.environment->assignAt(local.depth, local.slot, result);
+                return result;
+            };
+        } else {
+            exprResult = [value, name](Interpreter& in) {
+                lox_literal result = value(in);
+                in.globals->assign(name, result);
+                return result;
+            };
+        }
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Logical& expr) override {
+        CompiledExpr left = compile(*expr.left);
+        CompiledExpr right = compile(*expr.right);
+        if (expr.op.getTokenType() == TokenType::OR) {
+            exprResult = [left, right](Interpreter& in) {
+                lox_literal value = left(in);
+                if (isTruthy(value)) return value;
+                return right(in);
+            };
+        } else {
+            exprResult = [left, right](Interpreter& in) {
+                lox_literal value = left(in);
+                if (!isTruthy(value)) return value;
+                return right(in);
+            };
+        }
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Binary& expr) override {
+        CompiledExpr left = compile(*expr.left);
+        CompiledExpr right = compile(*expr.right);
+        switch (expr.op.getTokenType()) {
+            case TokenType::PLUS:          exprResult = numberOp(left, right, expr.op, Value::add); break;
+            case TokenType::MINUS:         exprResult = numberOp(left, right, expr.op, Value::subtract); break;
+            case TokenType::STAR:          exprResult = numberOp(left, right, expr.op, Value::multiply); break;
+            case TokenType::SLASH:         exprResult = numberOp(left, right, expr.op, Value::divide); break;
+            case TokenType::GREATER:       exprResult = numberOp(left, right, expr.op, [](const lox_literal& a, const lox_literal& b) -> lox_literal { return a.asNumber() > b.asNumber(); }); break;
+            case TokenType::GREATER_EQUAL: exprResult = numberOp(left, right, expr.op, [](const lox_literal& a, const lox_literal& b) -> lox_literal { return a.asNumber() >= b.asNumber(); }); break;
+            case TokenType::LESS:          exprResult = numberOp(left, right, expr.op, [](const lox_literal& a, const lox_literal& b) -> lox_literal { return a.asNumber() < b.asNumber(); }); break;
+            case TokenType::LESS_EQUAL:    exprResult = numberOp(left, right, expr.op, [](const lox_literal& a, const lox_literal& b) -> lox_literal { return a.asNumber() <= b.asNumber(); }); break;
+            case TokenType::EQUAL_EQUAL:
+                exprResult = [left, right](Interpreter& in) -> lox_literal {
+                    lox_literal a = left(in);
+                    lox_literal b = right(in);
+                    return a == b;
+                };
+                break;
+            case TokenType::BANG_EQUAL:
+                exprResult = [left, right](Interpreter& in) -> lox_literal {
+                    lox_literal a = left(in);
+                    lox_literal b = right(in);
+                    return a != b;
+                };
+                break;
+            default: {
+                Token op = expr.op;
+                exprResult = [left, right, op](Interpreter& in) {
+                    lox_literal a = left(in);
+                    lox_literal b = right(in);
+                    return Interpreter::applyBinary(op, a, b);
+                };
+            }
+        }
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Unary& expr) override {
+        CompiledExpr right = compile(*expr.right);
+        Token op = expr.op;
+        if (op.getTokenType() == TokenType::MINUS) {
+            exprResult = [right, op](Interpreter& in) -> lox_literal {
+                lox_literal value = right(in);
+                if (value.isNumber()) return Value::negate(value);
+                return Interpreter::applyUnary(op, value);
+            };
+        } else {
+            exprResult = [right, op](Interpreter& in) {
+                return Interpreter::applyUnary(op, right(in));
+            };
+        }
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Call& expr) override {
+        std::vector<CompiledExpr> arguments;
+        arguments.reserve(expr.arguments.size());
+        for (const auto& argument : expr.arguments) {
+            arguments.push_back(compile(*argument));
+        }
+        Token paren = expr.paren;
+
+        if (expr.method) {
+            CompiledExpr object = compile(*expr.method->object);
+            Token name = expr.method->name;
+            auto cache = std::make_shared<GetCache>();
+            exprResult = [object, name, cache, arguments, paren](Interpreter& in) {
+                Interpreter::MethodCallee callee = in.lookUpMethod(name, object(in), *cache);
+                std::vector<lox_literal> values;
+                values.reserve(arguments.size());
+                for (const auto& argument : arguments) {
+                    values.push_back(argument(in));
+                }
+                return in.callMethod(paren, callee, values);
+            };
+            return std::monostate{};
+        }
+
+        CompiledExpr callee = compile(*expr.callee);
+        exprResult = [callee, arguments, paren](Interpreter& in) {
+            lox_literal function = callee(in);
+            std::vector<lox_literal> values;
+            values.reserve(arguments.size());
+            for (const auto& argument : arguments) {
+                values.push_back(argument(in));
+            }
+            return in.callValue(paren, function, values);
+        };
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Get& expr) override {
+        CompiledExpr object = compile(*expr.object);
+        Token name = expr.name;
+        auto cache = std::make_shared<GetCache>();
+        exprResult = [object, name, cache](Interpreter& in) {
+            lox_literal value = object(in);
+            if (!value.isInstance()) {
+                throw RuntimeError(name, "Only instances have properties.");
+            }
+            return value.asInstance()->get(name, *cache);
+        };
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Set& expr) override {
+        CompiledExpr object = compile(*expr.object);
+        CompiledExpr value = compile(*expr.value);
+        Token name = expr.name;
+        auto cache = std::make_shared<SetCache>();
+        exprResult = [object, value, name, cache](Interpreter& in) {
+            lox_literal target = object(in);
+            if (!target.isInstance()) {
+                throw RuntimeError(name, "Only instances have fields.");
+            }
+            lox_literal result = value(in);
+            target.asInstance()->set(name, result, *cache);
+            return result;
+        };
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Super& expr) override {
+        int distance = expr.local.depth;
+        Token method = expr.method;
+        exprResult = [distance, method](Interpreter& in) {
+            return in.superMethod(distance, method);
+        };
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Expression& stmt) override {
+        CompiledExpr expression = compile(*stmt.expression);
+        stmtResult = [expression](Interpreter& in) {
+            expression(in);
+            return Completion::NORMAL;
+        };
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Print& stmt) override {
+        CompiledExpr expression = compile(*stmt.expression);
+        stmtResult = [expression](Interpreter& in) {
+            std::cout << literal_to_string(expression(in)) << std::endl;
+            return Completion::NORMAL;
+        };
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Var& stmt) override {
+        Token name = stmt.name;
+        int slot = stmt.slot;
+        if (stmt.initializer) {
+            CompiledExpr initializer = compile(*stmt.initializer);
+            stmtResult = [initializer, name, slot](Interpreter& in) {
+                in.defineVariable(name, slot, initializer(in));
+                return Completion::NORMAL;
+            };
+        } else {
+            stmtResult = [name, slot](Interpreter& in) {
+                in.defineVariable(name, slot, std::monostate{});
+                return Completion::NORMAL;
+            };
+        }
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Block& stmt) override {
+        auto statements = std::make_shared<std::vector<CompiledStmt>>(compile(stmt.statements));
+        size_t slotCount = stmt.slotCount;
+        if (stmt.captured) {
+            stmtResult = [statements, slotCount](Interpreter& in) {
+                return in.executeCompiled(*statements, makeRef<Environment>(in.environment, slotCount));
+            };
+            return std::monostate{};
+        }
+        stmtResult = [statements, slotCount](Interpreter& in) {
+            auto frame = in.acquireFrame(in.environment, slotCount);
+            Completion completion = in.executeCompiled(*statements, frame);
+            in.releaseFrame(std::move(frame));
+            return completion;
+        };
+        return std::monostate{};
+    }
+
+    lox_literal visit(const If& stmt) override {
+        CompiledExpr condition = compile(*stmt.condition);
+        CompiledStmt thenBranch = stmt.thenBranch ? compile(*stmt.thenBranch) : CompiledStmt();
+        CompiledStmt elseBranch = stmt.elseBranch ? compile(*stmt.elseBranch) : CompiledStmt();
+        stmtResult = [condition, thenBranch, elseBranch](Interpreter& in) {
+            if (isTruthy(condition(in))) {
+                if (thenBranch) return thenBranch(in);
+            } else if (elseBranch) {
+                return elseBranch(in);
+            }
+            return Completion::NORMAL;
+        };
+        return std::monostate{};
+    }
+
+    lox_literal visit(const While& stmt) override {
+        CompiledExpr condition = compile(*stmt.condition);
+        CompiledStmt body = compile(*stmt.body);
+        const While* loop = &stmt;
+        stmtResult = [condition, body, loop](Interpreter& in) {
+            while (isTruthy(condition(in))) {
+                if (body(in) == Completion::RETURN) return Completion::RETURN;
+                if (in.jit && in.jit->onBackEdge(in, *loop)) break;
+                if (in.tracer && in.tracer->onBackEdge(in, *loop)) break;
+            }
+            return Completion::NORMAL;
+        };
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Function& stmt) override {
+        auto declaration = Heap::make<Function>(stmt);
+        auto body = compileBody(stmt);
+        stmtResult = [declaration, body](Interpreter& in) {
+            auto function = makeRef<LoxFunction>(declaration, in.environment, false);
+            function->setCompiledBody(body);
+            in.defineVariable(declaration->name, declaration->slot, function);
+            return Completion::NORMAL;
+        };
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Return& stmt) override {
+        if (stmt.tailCall) {
+            stmtResult = compileTailCall(static_cast<const Call&>(*stmt.value));
+        } else if (stmt.value) {
+            CompiledExpr value = compile(*stmt.value);
+            stmtResult = [value](Interpreter& in) { return in.returnWith(value(in)); };
+        } else {
+            stmtResult = [](Interpreter& in) { return in.returnWith(std::monostate{}); };
+        }
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Class& stmt) override {
+        auto methods = std::make_shared<std::vector<std::shared_ptr<CompiledBody>>>();
+        for (const auto& method : stmt.methods) {
+            methods->push_back(compileBody(*method));
+        }
+        // Keep the node alive for defineClass, which reads its name, superclass and methods
+        auto declaration = Heap::make<Class>(stmt);
+        stmtResult = [declaration, methods](Interpreter& in) {
+            in.defineClass(*declaration, methods.get());
+            return Completion::NORMAL;
+        };
+        return std::monostate{};
+    }
+
+private:
+    CompiledExpr compile(const Expr& expr) {
+        expr.accept(*this);
+        return std::move(exprResult);
+    }
+
+    CompiledStmt compile(const Stmt& stmt) {
+        stmt.accept(*this);
+        return std::move(stmtResult);
+    }
+
+    /** 'return f(...)': evaluated as in visit(Call), then handed to the interpreter as a tail call. */
+    CompiledStmt compileTailCall(const Call& expr) {
+        std::vector<CompiledExpr> arguments;
+        arguments.reserve(expr.arguments.size());
+        for (const auto& argument : expr.arguments) {
+            arguments.push_back(compile(*argument));
+        }
+        Token paren = expr.paren;
+
+        if (expr.method) {
+            CompiledExpr object = compile(*expr.method->object);
+            Token name = expr.method->name;
+            auto cache = std::make_shared<GetCache>();
+            return [object, name, cache, arguments, paren](Interpreter& in) {
+                Interpreter::MethodCallee callee = in.lookUpMethod(name, object(in), *cache);
+                std::vector<lox_literal> values;
+                values.reserve(arguments.size());
+                for (const auto& argument : arguments) {
+                    values.push_back(argument(in));
+                }
+                return in.tailCallMethod(paren, callee, std::move(values));
+            };
+        }
+
+        CompiledExpr callee = compile(*expr.callee);
+        return [callee, arguments, paren](Interpreter& in) {
+            lox_literal function = callee(in);
+            std::vector<lox_literal> values;
+            values.reserve(arguments.size());
+            for (const auto& argument : arguments) {
+                values.push_back(argument(in));
+            }
+            return in.tailCallValue(paren, function, std::move(values));
+        };
+    }
+
+    /** Compile a function body. Its statements run directly in the call's environment, as in LoxFunction::call. */
+    std::shared_ptr<CompiledBody> compileBody(const Function& function) {
+        auto body = std::make_shared<CompiledBody>();
+        if (auto block = std::dynamic_pointer_cast<Block>(function.body)) {
+            body->statements = compile(block->statements);
+        } else {
+            body->statements.push_back(compile(*function.body));
+        }
+        return body;
+    }
+
+    /** A variable read with its resolved distance and slot baked in, or a global lookup if it has none. */
+    CompiledExpr compileLookup(const LocalSlot& local, const Token& name) {
+        if (!local.isGlobal()) {
+            return [local](Interpreter& in) { return in.environment->getAt(local.depth, local.slot); };
+        }
+        Token global = name;
+        return [global](Interpreter& in) { return in.globals->getValue(global); };
+    }
+
+    /**
+     * An arithmetic or comparison operator with a fast path for two numbers.
+     * Anything else goes through Interpreter::applyBinary for the error checks.
+     */
+    template <typename Op>
+    static CompiledExpr numberOp(CompiledExpr left, CompiledExpr right, Token op, Op apply) {
+        return [left = std::move(left), right = std::move(right), op = std::move(op), apply](Interpreter& in) -> lox_literal {
+            lox_literal a = left(in);
+            lox_literal b = right(in);
+            if (a.isNumber() && b.isNumber()) return apply(a, b);
+            return Interpreter::applyBinary(op, a, b);
+        };
+    }
+
+    CompiledExpr exprResult;
+    CompiledStmt stmtResult;
+};
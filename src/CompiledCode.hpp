@@ -0,0 +1,21 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <vector>
+#include "literal.hpp"
+#include "Completion.hpp"
+
+class Interpreter;
+
+/**
+ * Expressions and statements pre-compiled by the ClosureCompiler. Each one
+ * is a C++ callable with its operator, resolved variable distance and child
+ * callables captured up front, so running it needs no AST dispatch.
+ */
+using CompiledExpr = std::function<lox_literal(Interpreter&)>;
+using CompiledStmt = std::function<Completion(Interpreter&)>;
+
+/** The compiled body of a function, shared by every LoxFunction made from its declaration. */
+struct CompiledBody {
+    std::vector<CompiledStmt> statements;
+};
@@ -0,0 +1,571 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Expr.hpp"
+#include "Stmt.hpp"
+#include "Chunk.hpp"
+#include "VMObject.hpp"
+#include "VM.hpp"
+#include "Resolver.hpp"
+#include "RuntimeError.hpp"
+
+/**
+ * The Compiler turns a resolved AST into bytecode for the VM. It runs after
+ * the Resolver has rejected invalid programs, so it only has to assign stack
+ * slots to locals, build upvalue lists for closures and emit instructions.
+ * Every instruction that can fail at runtime records the line of the token
+ * the Interpreter would report for the same error.
+ */
+class Compiler : public ExprVisitorEval, public StmtVisitorEval {
+public:
+    explicit Compiler(VM& vm) : vm(vm) {}
+
+    ObjFunction* compile(const std::vector<std::shared_ptr<Stmt>>& statements) {
+        FunctionState script(nullptr, vm.newFunction(nullptr), FunctionType::NONE);
+        current = &script;
+        for (const auto& statement : statements) {
+            compile(*statement);
+        }
+        emitReturn();
+        current = nullptr;
+        return script.function;
+    }
+
+    lox_literal visit(const Expression& stmt) override {
+        compile(*stmt.expression);
+        emitOp(OpCode::POP);
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Print& stmt) override {
+        compile(*stmt.expression);
+        emitOp(OpCode::PRINT);
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Var& stmt) override {
+        if (stmt.initializer) {
+            compile(*stmt.initializer);
+        } else {
+            emitOp(OpCode::NIL);
+        }
+        defineVariable(stmt.name);
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Block& stmt) override {
+        beginScope();
+        for (const auto& statement : stmt.statements) {
+            compile(*statement);
+        }
+        endScope();
+        return std::monostate{};
+    }
+
+    /** Local functions claim their slot before the body is compiled so they can recurse. */
+    lox_literal visit(const Function& stmt) override {
+        if (current->scopeDepth > 0) {
+            addLocal(stmt.name.getLexeme());
+            function(stmt, FunctionType::FUNCTION);
+        } else {
+            function(stmt, FunctionType::FUNCTION);
+            defineVariable(stmt.name);
+        }
+        return std::monostate{};
+    }
+
+    lox_literal visit(const If& stmt) override {
+        compile(*stmt.condition);
+        size_t thenJump = emitJump(OpCode::JUMP_IF_FALSE);
+        emitOp(OpCode::POP);
+        compile(*stmt.thenBranch);
+        size_t elseJump = emitJump(OpCode::JUMP);
+        patchJump(thenJump);
+        emitOp(OpCode::POP);
+        if (stmt.elseBranch) {
+            compile(*stmt.elseBranch);
+        }
+        patchJump(elseJump);
+        return std::monostate{};
+    }
+
+    lox_literal visit(const While& stmt) override {
+        size_t loopStart = currentChunk().code.size();
+        compile(*stmt.condition);
+        size_t exitJump = emitJump(OpCode::JUMP_IF_FALSE);
+        emitOp(OpCode::POP);
+        compile(*stmt.body);
+        emitLoop(loopStart);
+        patchJump(exitJump);
+        emitOp(OpCode::POP);
+        return std::monostate{};
+    }
+
+    /** Initializers always hand back 'this', which lives in slot 0. */
+    lox_literal visit(const Return& stmt) override {
+        if (current->type == FunctionType::INITIALIZER) {
+            emitOp(OpCode::GET_LOCAL);
+            emitShort(0);
+        } else if (stmt.value) {
+            compile(*stmt.value);
+        } else {
+            emitOp(OpCode::NIL);
+        }
+        emitOp(OpCode::RETURN);
+        return std::monostate{};
+    }
+
+    /**
+     * Create the class, then (for subclasses) bind 'super' in a scope that
+     * encloses every method, copy inherited methods down and attach the
+     * class's own methods.
+     */
+    lox_literal visit(const Class& stmt) override {
+        std::string_view name = stmt.name.getLexeme();
+        uint16_t nameConstant = identifierConstant(name);
+        bool isLocal = current->scopeDepth > 0;
+        if (isLocal) {
+            addLocal(name);
+        }
+        line = stmt.name.getLine();
+        emitOp(OpCode::CLASS);
+        emitShort(nameConstant);
+        if (!isLocal) {
+            defineVariable(stmt.name);
+        }
+
+        ClassState classState{currentClass};
+        currentClass = &classState;
+
+        if (stmt.superclass.has_value()) {
+            compile(*stmt.superclass.value());
+            beginScope();
+            addLocal("super");
+            namedVariable(name, stmt.name.getLine(), false);
+            line = stmt.name.getLine();
+            emitOp(OpCode::INHERIT);
+            classState.hasSuperclass = true;
+        }
+
+        namedVariable(name, stmt.name.getLine(), false);
+        for (const auto& method : stmt.methods) {
+            uint16_t methodName = identifierConstant(method->name.getLexeme());
+            FunctionType type = method->name.getLexeme() == "init" ? FunctionType::INITIALIZER : FunctionType::METHOD;
+            function(*method, type);
+            emitOp(OpCode::METHOD);
+            emitShort(methodName);
+        }
+        emitOp(OpCode::POP);
+
+        if (classState.hasSuperclass) {
+            endScope();
+        }
+        currentClass = classState.enclosing;
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Literal& expr) override {
+        const lox_literal& value = expr.value;
+        if (value.isNumber()) {
+            emitConstant(VMValue::fromNumber(value.asNumber()));
+        } else if (value.isString()) {
+            emitConstant(VMValue::fromObj(vm.copyString(value.asString())));
+        } else if (value.isBool()) {
+            emitOp(value.asBool() ? OpCode::TRUE : OpCode::FALSE);
+        } else {
+            emitOp(OpCode::NIL);
+        }
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Grouping& expr) override {
+        compile(*expr.expression);
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Unary& expr) override {
+        compile(*expr.right);
+        line = expr.op.getLine();
+        switch (expr.op.getTokenType()) {
+            case TokenType::MINUS: emitOp(OpCode::NEGATE); break;
+            case TokenType::BANG: emitOp(OpCode::NOT); break;
+            default: emitOp(OpCode::NIL); break;
+        }
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Binary& expr) override {
+        compile(*expr.left);
+        compile(*expr.right);
+        line = expr.op.getLine();
+        switch (expr.op.getTokenType()) {
+            case TokenType::PLUS: emitOp(OpCode::ADD); break;
+            case TokenType::MINUS: emitOp(OpCode::SUBTRACT); break;
+            case TokenType::STAR: emitOp(OpCode::MULTIPLY); break;
+            case TokenType::SLASH: emitOp(OpCode::DIVIDE); break;
+            case TokenType::EQUAL_EQUAL: emitOp(OpCode::EQUAL); break;
+            case TokenType::BANG_EQUAL: emitOp(OpCode::NOT_EQUAL); break;
+            case TokenType::GREATER: emitOp(OpCode::GREATER); break;
+            case TokenType::GREATER_EQUAL: emitOp(OpCode::GREATER_EQUAL); break;
+            case TokenType::LESS: emitOp(OpCode::LESS); break;
+            case TokenType::LESS_EQUAL: emitOp(OpCode::LESS_EQUAL); break;
+            default:
+                emitOp(OpCode::POP);
+                emitOp(OpCode::POP);
+                emitOp(OpCode::NIL);
+                break;
+        }
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Logical& expr) override {
+        compile(*expr.left);
+        if (expr.op.getTokenType() == TokenType::OR) {
+            size_t elseJump = emitJump(OpCode::JUMP_IF_FALSE);
+            size_t endJump = emitJump(OpCode::JUMP);
+            patchJump(elseJump);
+            emitOp(OpCode::POP);
+            compile(*expr.right);
+            patchJump(endJump);
+        } else {
+            size_t endJump = emitJump(OpCode::JUMP_IF_FALSE);
+            emitOp(OpCode::POP);
+            compile(*expr.right);
+            patchJump(endJump);
+        }
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Variable& expr) override {
+        namedVariable(expr.name.getLexeme(), expr.name.getLine(), false);
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Assign& expr) override {
+        compile(*expr.value);
+        namedVariable(expr.name.getLexeme(), expr.name.getLine(), true);
+        return std::monostate{};
+    }
+
+    /**
+     * 'obj.name(args)' and 'super.name(args)' look the method up before the
+     * arguments are evaluated (matching the Interpreter's evaluation order)
+     * but call it without allocating a bound method.
+     */
+    lox_literal visit(const Call& expr) override {
+        if (auto get = dynamic_cast<const Get*>(expr.callee.get())) {
+            compile(*get->object);
+            line = get->name.getLine();
+            emitOp(OpCode::GET_METHOD);
+            emitShort(identifierConstant(get->name.getLexeme()));
+            compileArguments(expr);
+            emitOp(OpCode::CALL_METHOD);
+        } else if (auto super = dynamic_cast<const Super*>(expr.callee.get())) {
+            namedVariable("this", super->keyword.getLine(), false);
+            namedVariable("super", super->keyword.getLine(), false);
+            line = super->method.getLine();
+            emitOp(OpCode::SUPER_METHOD);
+            emitShort(identifierConstant(super->method.getLexeme()));
+            compileArguments(expr);
+            emitOp(OpCode::CALL_METHOD);
+        } else {
+            compile(*expr.callee);
+            compileArguments(expr);
+            emitOp(OpCode::CALL);
+        }
+        emitByte(static_cast<uint8_t>(expr.arguments.size()));
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Get& expr) override {
+        compile(*expr.object);
+        line = expr.name.getLine();
+        emitOp(OpCode::GET_PROPERTY);
+        emitShort(identifierConstant(expr.name.getLexeme()));
+        return std::monostate{};
+    }
+
+    /** The receiver is checked before the value is evaluated, as in the Interpreter. 'this' needs no check. */
+    lox_literal visit(const Set& expr) override {
+        compile(*expr.object);
+        if (!dynamic_cast<const This*>(expr.object.get())) {
+            line = expr.name.getLine();
+            emitOp(OpCode::CHECK_INSTANCE);
+        }
+        compile(*expr.value);
+        line = expr.name.getLine();
+        emitOp(OpCode::SET_PROPERTY);
+        emitShort(identifierConstant(expr.name.getLexeme()));
+        return std::monostate{};
+    }
+
+    lox_literal visit(const This& expr) override {
+        namedVariable("this", expr.keyword.getLine(), false);
+        return std::monostate{};
+    }
+
+    lox_literal visit(const Super& expr) override {
+        namedVariable("this", expr.keyword.getLine(), false);
+        namedVariable("super", expr.keyword.getLine(), false);
+        line = expr.method.getLine();
+        emitOp(OpCode::GET_SUPER);
+        emitShort(identifierConstant(expr.method.getLexeme()));
+        return std::monostate{};
+    }
+
+private:
+    struct Local {
+        std::string_view name; // Views the source, like the token it comes from
+        int depth;
+        bool isCaptured;
+    };
+
+    struct Upvalue {
+        uint16_t index;
+        bool isLocal;
+    };
+
+    struct FunctionState {
+        FunctionState(FunctionState* enclosing, ObjFunction* function, FunctionType type)
+            : enclosing(enclosing), function(function), type(type) {
+            // Slot 0 holds the receiver for methods and the callee otherwise
+            bool isMethod = type == FunctionType::METHOD || type == FunctionType::INITIALIZER;
+            locals.push_back(Local{isMethod ? "this" : "", 0, false});
+        }
+        FunctionState* enclosing;
+        ObjFunction* function;
+        FunctionType type;
+        std::vector<Local> locals;
+        std::vector<Upvalue> upvalues;
+        std::unordered_map<std::string_view, uint16_t> identifiers;
+        int scopeDepth = 0;
+    };
+
+    struct ClassState {
+        ClassState* enclosing;
+        bool hasSuperclass = false;
+    };
+
+    static constexpr size_t MAX_INDEX = UINT16_MAX;
+
+    VM& vm;
+    FunctionState* current = nullptr;
+    ClassState* currentClass = nullptr;
+    int line = 0;
+
+    void compile(const Stmt& stmt) {
+        stmt.accept(*this);
+    }
+
+    void compile(const Expr& expr) {
+        expr.accept(*this);
+    }
+
+    void compileArguments(const Call& expr) {
+        for (const auto& argument : expr.arguments) {
+            compile(*argument);
+        }
+        line = expr.paren.getLine();
+    }
+
+    void function(const Function& stmt, FunctionType type) {
+        FunctionState state(current, vm.newFunction(vm.copyString(stmt.name.getLexeme())), type);
+        current = &state;
+        beginScope();
+        state.function->arity = static_cast<int>(stmt.params.size());
+        for (const auto& param : stmt.params) {
+            addLocal(param.getLexeme());
+        }
+        // Parameters and body statements share the function's scope, as in the Resolver
+        if (auto block = std::dynamic_pointer_cast<Block>(stmt.body)) {
+            for (const auto& statement : block->statements) {
+                compile(*statement);
+            }
+        } else {
+            compile(*stmt.body);
+        }
+        emitReturn();
+        state.function->upvalueCount = static_cast<int>(state.upvalues.size());
+        current = state.enclosing;
+
+        emitOp(OpCode::CLOSURE);
+        emitShort(makeConstant(VMValue::fromObj(state.function)));
+        for (const auto& upvalue : state.upvalues) {
+            emitByte(upvalue.isLocal ? 1 : 0);
+            emitShort(upvalue.index);
+        }
+    }
+
+    void defineVariable(const Token& name) {
+        if (current->scopeDepth > 0) {
+            addLocal(name.getLexeme());
+            return;
+        }
+        line = name.getLine();
+        emitOp(OpCode::DEFINE_GLOBAL);
+        emitShort(vm.globalSlot(std::string(name.getLexeme())));
+    }
+
+    void namedVariable(std::string_view name, int nameLine, bool assign) {
+        OpCode op;
+        int arg = resolveLocal(*current, name);
+        if (arg != -1) {
+            op = assign ? OpCode::SET_LOCAL : OpCode::GET_LOCAL;
+        } else if ((arg = resolveUpvalue(*current, name)) != -1) {
+            op = assign ? OpCode::SET_UPVALUE : OpCode::GET_UPVALUE;
+        } else {
+            arg = vm.globalSlot(std::string(name));
+            op = assign ? OpCode::SET_GLOBAL : OpCode::GET_GLOBAL;
+        }
+        line = nameLine;
+        emitOp(op);
+        emitShort(static_cast<uint16_t>(arg));
+    }
+
+    void addLocal(std::string_view name) {
+        if (current->locals.size() > MAX_INDEX) {
+            throw RuntimeError(Token(TokenType::IDENTIFIER, name, std::monostate{}, line), "Too many local variables in function.");
+        }
+        current->locals.push_back(Local{name, current->scopeDepth, false});
+    }
+
+    int resolveLocal(FunctionState& state, std::string_view name) {
+        for (int i = static_cast<int>(state.locals.size()) - 1; i >= 0; --i) {
+            if (state.locals[i].name == name) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    int resolveUpvalue(FunctionState& state, std::string_view name) {
+        if (state.enclosing == nullptr) return -1;
+        int local = resolveLocal(*state.enclosing, name);
+        if (local != -1) {
+            state.enclosing->locals[local].isCaptured = true;
+            return addUpvalue(state, static_cast<uint16_t>(local), true);
+        }
+        int upvalue = resolveUpvalue(*state.enclosing, name);
+        if (upvalue != -1) {
+            return addUpvalue(state, static_cast<uint16_t>(upvalue), false);
+        }
+        return -1;
+    }
+
+    int addUpvalue(FunctionState& state, uint16_t index, bool isLocal) {
+        for (size_t i = 0; i < state.upvalues.size(); ++i) {
+            if (state.upvalues[i].index == index && state.upvalues[i].isLocal == isLocal) {
+                return static_cast<int>(i);
+            }
+        }
+        if (state.upvalues.size() > MAX_INDEX) {
+            throw RuntimeError(Token(TokenType::IDENTIFIER, "", std::monostate{}, line), "Too many closure variables in function.");
+        }
+        state.upvalues.push_back(Upvalue{index, isLocal});
+        return static_cast<int>(state.upvalues.size() - 1);
+    }
+
+    void beginScope() {
+        current->scopeDepth++;
+    }
+
+    /** Pop the scope's locals, hoisting any that closures captured. */
+    void endScope() {
+        current->scopeDepth--;
+        auto& locals = current->locals;
+        while (!locals.empty() && locals.back().depth > current->scopeDepth) {
+            if (locals.back().isCaptured) {
+                emitOp(OpCode::CLOSE_UPVALUE);
+                locals.pop_back();
+                continue;
+            }
+            uint16_t count = 0;
+            while (!locals.empty() && locals.back().depth > current->scopeDepth && !locals.back().isCaptured) {
+                locals.pop_back();
+                count++;
+            }
+            if (count == 1) {
+                emitOp(OpCode::POP);
+            } else {
+                emitOp(OpCode::POPN);
+                emitShort(count);
+            }
+        }
+    }
+
+    Chunk& currentChunk() {
+        return current->function->chunk;
+    }
+
+    void emitByte(uint8_t byte) {
+        currentChunk().write(byte, line);
+    }
+
+    void emitOp(OpCode op) {
+        emitByte(static_cast<uint8_t>(op));
+    }
+
+    void emitShort(uint16_t value) {
+        emitByte(static_cast<uint8_t>(value >> 8));
+        emitByte(static_cast<uint8_t>(value & 0xff));
+    }
+
+    void emitReturn() {
+        if (current->type == FunctionType::INITIALIZER) {
+            emitOp(OpCode::GET_LOCAL);
+            emitShort(0);
+        } else {
+            emitOp(OpCode::NIL);
+        }
+        emitOp(OpCode::RETURN);
+    }
+
+    size_t emitJump(OpCode op) {
+        emitOp(op);
+        for (int i = 0; i < 4; ++i) emitByte(0xff);
+        return currentChunk().code.size() - 4;
+    }
+
+    void patchJump(size_t offset) {
+        uint32_t jump = static_cast<uint32_t>(currentChunk().code.size() - offset - 4);
+        auto& code = currentChunk().code;
+        code[offset] = static_cast<uint8_t>(jump >> 24);
+        code[offset + 1] = static_cast<uint8_t>(jump >> 16);
+        code[offset + 2] = static_cast<uint8_t>(jump >> 8);
+        code[offset + 3] = static_cast<uint8_t>(jump);
+    }
+
+    void emitLoop(size_t loopStart) {
+        emitOp(OpCode::LOOP);
+        uint32_t offset = static_cast<uint32_t>(currentChunk().code.size() - loopStart + 4);
+        emitByte(static_cast<uint8_t>(offset >> 24));
+        emitByte(static_cast<uint8_t>(offset >> 16));
+        emitByte(static_cast<uint8_t>(offset >> 8));
+        emitByte(static_cast<uint8_t>(offset));
+    }
+
+    uint16_t makeConstant(VMValue value) {
+        size_t index = currentChunk().addConstant(value);
+        if (index > MAX_INDEX) {
+            throw RuntimeError(Token(TokenType::IDENTIFIER, "", std::monostate{}, line), "Too many constants in one chunk.");
+        }
+        return static_cast<uint16_t>(index);
+    }
+
+    void emitConstant(VMValue value) {
+        emitOp(OpCode::CONSTANT);
+        emitShort(makeConstant(value));
+    }
+
+    uint16_t identifierConstant(std::string_view name) {
+        auto it = current->identifiers.find(name);
+        if (it != current->identifiers.end()) {
+            return it->second;
+        }
+        uint16_t index = makeConstant(VMValue::fromObj(vm.copyString(name)));
+        current->identifiers.emplace(name, index);
+        return index;
+    }
+};
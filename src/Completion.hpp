@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * How a statement finished. RETURN means a 'return' statement ran: the
+ * blocks and loops around it stop, and the call it returns from takes the
+ * value the interpreter holds for it (Interpreter::takeReturnValue). This
+ * keeps returning an ordinary control-flow path instead of a C++ exception.
+ */
+enum class Completion : uint8_t {
+    NORMAL,
+    RETURN
+};
@@ -1,90 +1,140 @@
 #pragma once
 
 #include <iostream> // For std::cout and std::cerr
-#include <map>
 #include <memory>
 #include <string>
 #include <vector>
 #include "literal.hpp"
 #include "token.hpp"
+#include "Symbol.hpp"
 #include "RuntimeError.hpp"
+#include "Heap.hpp"
+#include "Gc.hpp"
+#include "Ref.hpp"
 
-class Environment : public std::enable_shared_from_this<Environment> {
+/**
+ * A scope's variables. Local scopes keep theirs in a fixed array of slots
+ * numbered by the Resolver in declaration order, so reads and writes are an
+ * index instead of a lookup. The global scope has no slots; its variables
+ * live in a dense table indexed by the SymbolId of their name, which is
+ * fixed before the program is resolved. An entry stays undefined until its
+ * declaration runs, so code may refer to a global defined after it.
+ */
+class Environment : public RefCounted, public Collectable<Environment>, public HeapObject<HeapKind::ENVIRONMENT> {
 public:
-    explicit Environment(std::shared_ptr<Environment> enclosing = nullptr)
-        : enclosing(enclosing) {}
+    explicit Environment(Ref<Environment> enclosing = nullptr, size_t slotCount = 0)
+        : slots(slotCount), enclosing(std::move(enclosing)) {}
 
-    void define(const std::string& name, const lox_literal& value = lox_literal()) {
-        values[name] = value;
+    /** Point a recycled environment at a new scope, with every slot nil. */
+    void reset(Ref<Environment> enclosing, size_t slotCount) {
+        slots.resize(slotCount);
+        this->enclosing = std::move(enclosing);
     }
 
-    lox_literal getAt(int distance, const std::string& name) const {
-        auto env = ancestor(distance);
-        if (!env) {
-            throw RuntimeError(Token(TokenType::IDENTIFIER, name, std::monostate{}, 0), 
-                              "Environment chain broken at distance " + std::to_string(distance));
-        }
-        auto it = env->values.find(name);
-        if (it != env->values.end()) {
-            return it->second;
-        }
-        throw RuntimeError(Token(TokenType::IDENTIFIER, name, std::monostate{}, 0), 
-                          "Undefined variable '" + name + "' at distance " + std::to_string(distance));
+    /** Drop the values and enclosing scope, keeping the slot storage for reuse. */
+    void clear() {
+        slots.clear();
+        enclosing.reset();
+    }
+
+    const lox_literal& getSlot(int slot) const {
+        return slots[slot];
+    }
+
+    void setSlot(int slot, const lox_literal& value) {
+        slots[slot] = value;
+    }
+
+    const lox_literal& getAt(int distance, int slot) const {
+        return ancestorAt(distance)->slots[slot];
+    }
+
+    void assignAt(int distance, int slot, const lox_literal& value) {
+        ancestorAt(distance)->slots[slot] = value;
+    }
+
+    void define(SymbolId name, const lox_literal& value = lox_literal()) {
+        if (name >= globals.size()) globals.resize(name + 1);
+        globals[name] = Global{value, true};
+    }
+
+    void define(const std::string& name, const lox_literal& value = lox_literal()) {
+        define(SymbolTable::intern(name), value);
     }
 
-    void assignAt(int distance, const Token& name, const lox_literal& value) {
-        ancestor(distance)->values[name.getLexeme()] = value;
+    /** A global of this environment; has(name) must hold. */
+    const lox_literal& get(SymbolId name) const {
+        return globals[name].value;
     }
 
-    lox_literal getValue(const Token& name) const {
-        const std::string& key = name.getLexeme();
-        if (values.count(key)) return values.at(key);
-        if (enclosing) return enclosing->getValue(name);
-        throw RuntimeError(name, "Undefined variable '" + key + "'.");
+    const lox_literal& getValue(const Token& name) const {
+        SymbolId index = name.getSymbol();
+        if (!has(index)) throw undefined(name);
+        return globals[index].value;
     }
 
     std::vector<std::string> getVariableNames() const {
         std::vector<std::string> names;
-        for (const auto& pair : values) {
-            names.push_back(pair.first);
+        for (SymbolId name = 0; name < globals.size(); ++name) {
+            if (globals[name].defined) names.push_back(SymbolTable::name(name));
         }
         return names;
     }
 
     void assign(const Token& name, const lox_literal& value) {
-        const std::string& key = name.getLexeme();
-        if (values.count(key)) {
-            values[key] = value;
-            return;
-        }
-        if (enclosing) {
-            enclosing->assign(name, value);
-            return;
-        }
-        throw RuntimeError(name, "Undefined variable '" + key + "'.");
+        SymbolId index = name.getSymbol();
+        if (!has(index)) throw undefined(name);
+        globals[index].value = value;
     }
 
-    std::shared_ptr<Environment> ancestor(int distance) const {
-        std::shared_ptr<Environment> env = const_cast<Environment*>(this)->shared_from_this();
-        for (int i = 0; i < distance; ++i) {
-            env = env->enclosing;
-        }
-        return env;
+    Ref<Environment> ancestor(int distance) const {
+        return Ref<Environment>(ancestorAt(distance));
     }
 
-    std::shared_ptr<Environment> getEnclosing() const {
+    const Ref<Environment>& getEnclosing() const {
         return enclosing;
     }
 
-    void setEnclosing(std::shared_ptr<Environment> enclosing) {
-        this->enclosing = enclosing;
+    void setEnclosing(Ref<Environment> enclosing) {
+        this->enclosing = std::move(enclosing);
+    }
+
+    bool has(SymbolId name) const {
+        return name < globals.size() && globals[name].defined;
+    }
+
+    void trace(GcTracer& tracer) const override {
+        for (const auto& value : slots) tracer.visit(value);
+        for (const auto& global : globals) tracer.visit(global.value);
+        tracer.visit(enclosing.get());
     }
 
-    bool has(const std::string& name) const {
-        return values.find(name) != values.end();
+    void clearReferences() override {
+        clear();
+        globals.clear();
     }
 
 private:
-    std::map<std::string, lox_literal> values;
-    std::shared_ptr<Environment> enclosing;
+    /** A global's table entry, undefined until its declaration has run. */
+    struct Global {
+        lox_literal value;
+        bool defined = false;
+    };
+
+    static RuntimeError undefined(const Token& name) {
+        return RuntimeError(name, "Undefined variable '" + std::string(name.getLexeme()) + "'.");
+    }
+
+    /** ancestor() without the reference counting, for slot access. */
+    Environment* ancestorAt(int distance) const {
+        const Environment* env = this;
+        for (int i = 0; i < distance; ++i) {
+            env = env->enclosing.get();
+        }
+        return const_cast<Environment*>(env);
+    }
+
+    std::vector<lox_literal, HeapAllocator<lox_literal, HeapKind::ENVIRONMENT>> slots;
+    std::vector<Global> globals; // Indexed by SymbolId; only the global environment has any
+    Ref<Environment> enclosing;
 };
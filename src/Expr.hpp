@@ -3,6 +3,18 @@
 #include <vector>
 #include "token.hpp"
 #include "literal.hpp"
+#include "InlineCache.hpp"
+
+/**
+ * Where the Resolver found a variable: how many environments up from the
+ * use, and which slot there. A depth of -1 means it was not found in any
+ * local scope and lives in the global table, indexed by its name's SymbolId.
+ */
+struct LocalSlot {
+    int depth = -1;
+    int slot = -1;
+    bool isGlobal() const { return depth < 0; }
+};
 
 class Expr;
 class ExprVisitorPrint;
@@ -70,6 +82,7 @@ public:
     lox_literal accept(ExprVisitorEval& visitor) const override { return visitor.visit(*this); }
     Token name;
     std::shared_ptr<Expr> value;
+    mutable LocalSlot local; // Set by the Resolver
 };
 
 class Binary : public Expr {
@@ -125,6 +138,7 @@ public:
     lox_literal accept(ExprVisitorEval& visitor) const override { return visitor.visit(*this); }
     Token keyword;
     Token method;
+    mutable LocalSlot local; // The 'super' scope, set by the Resolver
 };
 
 class This : public Expr {
@@ -133,16 +147,18 @@ public:
     void accept(const ExprVisitorPrint& visitor) const override { visitor.visit(*this); }
     lox_literal accept(ExprVisitorEval& visitor) const override { return visitor.visit(*this); }
     Token keyword;
+    mutable LocalSlot local; // Set by the Resolver
 };
 
 class Call : public Expr {
 public:
-    Call(std::shared_ptr<Expr> callee, Token paren, std::vector<std::shared_ptr<Expr>> arguments) : callee(callee), paren(paren), arguments(arguments) {}
+    Call(std::shared_ptr<Expr> callee, Token paren, std::vector<std::shared_ptr<Expr>> arguments);
     void accept(const ExprVisitorPrint& visitor) const override { visitor.visit(*this); }
     lox_literal accept(ExprVisitorEval& visitor) const override { return visitor.visit(*this); }
     std::shared_ptr<Expr> callee;
     Token paren;
     std::vector<std::shared_ptr<Expr>> arguments;
+    const Get* method; // The callee when it is a property access, as in obj.method(args); else nullptr
 };
 
 class Get : public Expr {
@@ -152,8 +168,12 @@ public:
     lox_literal accept(ExprVisitorEval& visitor) const override { return visitor.visit(*this); }
     std::shared_ptr<Expr> object;
     Token name;
+    mutable GetCache cache; // Filled in by the interpreter as the access runs
 };
 
+inline Call::Call(std::shared_ptr<Expr> callee, Token paren, std::vector<std::shared_ptr<Expr>> arguments)
+    : callee(callee), paren(paren), arguments(arguments), method(dynamic_cast<const Get*>(this->callee.get())) {}
+
 class Set : public Expr {
 public:
     Set(std::shared_ptr<Expr> object, Token name, std::shared_ptr<Expr> value) : object(object), name(name), value(value) {}
@@ -162,6 +182,7 @@ public:
     std::shared_ptr<Expr> object;
     Token name;
     std::shared_ptr<Expr> value;
+    mutable SetCache cache; // Filled in by the interpreter as the assignment runs
 };
 
 class Variable : public Expr {
@@ -170,6 +191,7 @@ public:
     void accept(const ExprVisitorPrint& visitor) const override { visitor.visit(*this); }
     lox_literal accept(ExprVisitorEval& visitor) const override { return visitor.visit(*this); }
     Token name;
+    mutable LocalSlot local; // Set by the Resolver
 };
 
 // All AST node fields referencing other nodes use std::shared_ptr<T>.
@@ -0,0 +1,122 @@
+#include "Gc.hpp"
+#include <algorithm>
+#include <climits>
+#include <vector>
+#include "LoxCallable.hpp"
+#include "LoxInstance.hpp"
+
+constinit Gc::State Gc::state{};
+
+GcObject::GcObject() {
+    Gc::State& state = Gc::state;
+    next = state.objects;
+    if (next) next->previous = this;
+    state.objects = this;
+    ++state.allocations;
+    ++state.stats.objects;
+}
+
+GcObject::~GcObject() {
+    Gc::State& state = Gc::state;
+    if (previous) {
+        previous->next = next;
+    } else {
+        state.objects = next;
+    }
+    if (next) next->previous = previous;
+    --state.stats.objects;
+}
+
+namespace {
+
+/** The managed object a value refers to, if any. */
+GcObject* referent(const lox_literal& value) {
+    if (value.isInstance()) return value.asInstance();
+    if (value.isCallable()) return dynamic_cast<GcObject*>(value.asCallable());
+    return nullptr;
+}
+
+/** A GcTracer that hands each reference to a function. */
+template <typename OnObject, typename OnValue>
+class TracerOf : public GcTracer {
+public:
+    TracerOf(OnObject onObject, OnValue onValue) : onObject(onObject), onValue(onValue) {}
+    void visit(const GcObject* object) override {
+        if (object) onObject(const_cast<GcObject*>(object));
+    }
+    void visit(const lox_literal& value) override { onValue(value); }
+
+private:
+    OnObject onObject;
+    OnValue onValue;
+};
+
+}
+
+void Gc::collect(std::initializer_list<const GcObject*> roots) {
+    // Objects still being constructed have no owner yet and cannot be traced; treat them as roots
+    constexpr long UNDER_CONSTRUCTION = LONG_MAX / 2;
+    for (GcObject* object = state.objects; object; object = object->next) {
+        long owners = object->counted().references();
+        object->externalReferences = owners > 0 ? owners : UNDER_CONSTRUCTION;
+        object->marked = false;
+    }
+
+    // Take off the references managed objects hold
+    auto discount = [](GcObject* object) {
+        if (object) --object->externalReferences;
+    };
+    TracerOf countInternal(discount, [&](const lox_literal& value) { discount(referent(value)); });
+    for (GcObject* object = state.objects; object; object = object->next) {
+        if (object->externalReferences != UNDER_CONSTRUCTION) object->trace(countInternal);
+    }
+
+    // Mark from the objects with owners outside the heap, and from the given roots
+    std::vector<GcObject*> pending;
+    auto mark = [&](GcObject* object) {
+        if (object && !object->marked) {
+            object->marked = true;
+            pending.push_back(object);
+        }
+    };
+    for (const GcObject* root : roots) {
+        mark(const_cast<GcObject*>(root));
+    }
+    for (GcObject* object = state.objects; object; object = object->next) {
+        if (object->externalReferences > 0) mark(object);
+    }
+    TracerOf markReferences(mark, [&](const lox_literal& value) { mark(referent(value)); });
+    while (!pending.empty()) {
+        GcObject* object = pending.back();
+        pending.pop_back();
+        if (object->externalReferences != UNDER_CONSTRUCTION) object->trace(markReferences);
+    }
+
+    // Hold every unmarked object while clearing, so each is freed only once all are cleared
+    std::vector<GcObject*> garbage;
+    for (GcObject* object = state.objects; object; object = object->next) {
+        if (!object->marked) {
+            object->counted().retain();
+            garbage.push_back(object);
+        }
+    }
+    for (GcObject* object : garbage) {
+        object->clearReferences();
+    }
+    for (GcObject* object : garbage) {
+        object->counted().release();
+    }
+    size_t freed = garbage.size();
+
+    state.stats.collections++;
+    state.stats.freed += freed;
+    state.stats.survivors = state.stats.objects;
+    state.allocations = 0;
+    state.nextCollection = std::max(THRESHOLD, 2 * state.stats.survivors);
+}
+
+void Gc::report(std::ostream& out) {
+    out << "gc collections: " << state.stats.collections << std::endl;
+    out << "gc objects: " << state.stats.objects << " live, " << state.stats.freed << " freed, "
+        << state.stats.survivors << " survived the last collection" << std::endl;
+}
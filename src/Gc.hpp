@@ -0,0 +1,111 @@
+#pragma once
+#include <cstddef>
+#include <initializer_list>
+#include <ostream>
+#include "literal.hpp"
+#include "Ref.hpp"
+
+class GcObject;
+
+/** Receives the references a GcObject holds, from GcObject::trace. */
+class GcTracer {
+public:
+    virtual ~GcTracer() = default;
+    /** An owning pointer to another managed object; null is ignored. */
+    virtual void visit(const GcObject* object) = 0;
+    /** A value, which refers to a managed object if it holds a function, class or instance. */
+    virtual void visit(const lox_literal& value) = 0;
+};
+
+/**
+ * Base of the runtime objects the collector manages: environments,
+ * functions, classes and instances. Every live one is on a list the
+ * collector walks. Subclasses derive through Collectable, which hooks up
+ * their reference count.
+ */
+class GcObject {
+public:
+    GcObject();
+    virtual ~GcObject();
+    GcObject(const GcObject&) = delete;
+    GcObject& operator=(const GcObject&) = delete;
+
+    /** Visit every reference this object holds to a managed object, and nothing else. */
+    virtual void trace(GcTracer& tracer) const = 0;
+
+    /** Drop those references; the collector does this to break up unreachable cycles. */
+    virtual void clearReferences() = 0;
+
+protected:
+    /** The base of this object that holds its reference count. */
+    virtual const RefCounted& counted() const = 0;
+
+private:
+    friend class Gc;
+    GcObject* previous = nullptr;
+    GcObject* next = nullptr;
+    long externalReferences = 0; // Scratch for Gc::collect
+    bool marked = false;
+};
+
+/** GcObject for a class T that derives from RefCounted. */
+template <typename T>
+class Collectable : public GcObject {
+protected:
+    const RefCounted& counted() const override {
+        return *static_cast<const T*>(this);
+    }
+};
+
+/**
+ * Mark-sweep collector for the cycles reference counting cannot free, such
+ * as a function stored in the environment it closes over, or instances
+ * that point at each other.
+ *
+ * A collection first works out which objects are referenced from outside
+ * the managed heap. Those are the interpreter's environment chain and the
+ * C++ locals and argument vectors that make up the evaluator's value
+ * stack. For each object it subtracts the references held by other
+ * managed objects from the object's reference count; an object with
+ * references left over is a root. Everything reachable from the roots is
+ * marked. Unmarked objects are reachable only from each other, so the
+ * collector clears their references and they are freed.
+ *
+ * Collections are triggered by allocation: once THRESHOLD objects, or
+ * twice the survivors of the last collection if that is more, have been
+ * created since the previous one, the next safe point
+ * (Interpreter::collectGarbageIfNeeded) collects.
+ */
+class Gc {
+public:
+    static constexpr size_t THRESHOLD = 10000;
+
+    struct Stats {
+        size_t collections = 0;
+        size_t objects = 0;   // Managed objects alive now
+        size_t freed = 0;     // Objects freed by collections, in total
+        size_t survivors = 0; // Objects left after the last collection
+    };
+
+    static bool shouldCollect() { return state.allocations >= state.nextCollection; }
+
+    /** Collect now; `roots` are marked in addition to the objects found referenced from outside. */
+    static void collect(std::initializer_list<const GcObject*> roots = {});
+
+    static const Stats& stats() { return state.stats; }
+
+    /** Print the collector's statistics, one line each. */
+    static void report(std::ostream& out);
+
+private:
+    friend class GcObject;
+
+    struct State {
+        GcObject* objects = nullptr; // All managed objects, newest first
+        size_t allocations = 0;      // Since the last collection
+        size_t nextCollection = THRESHOLD;
+        Stats stats;
+    };
+
+    static State state;
+};
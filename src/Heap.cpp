@@ -0,0 +1,82 @@
+#include "Heap.hpp"
+
+namespace {
+
+constexpr const char* KIND_NAMES[] = {"environment", "function", "instance", "ast"};
+
+/** Offset of the first block in a slab: the header, rounded up to the block alignment. */
+constexpr size_t firstBlockOffset(size_t headerSize) {
+    return (headerSize + Heap::GRANULE - 1) / Heap::GRANULE * Heap::GRANULE;
+}
+
+}
+
+Heap::FreeBlock* Heap::refill(size_t sizeClass) {
+    Cache& cache = local;
+    char* memory = static_cast<char*>(::operator new(SLAB_SIZE, std::align_val_t(SLAB_SIZE)));
+    size_t blockSize = (sizeClass + 1) * GRANULE;
+    size_t offset = firstBlockOffset(sizeof(Slab));
+
+    Slab* slab = reinterpret_cast<Slab*>(memory);
+    slab->next = cache.slabs;
+    slab->sizeClass = static_cast<uint32_t>(sizeClass);
+    slab->blockCount = static_cast<uint32_t>((SLAB_SIZE - offset) / blockSize);
+    slab->freeCount = 0;
+    cache.slabs = slab;
+
+    // Thread the blocks in address order, so fresh allocations walk the slab forwards
+    FreeBlock* head = nullptr;
+    for (size_t i = slab->blockCount; i-- > 0;) {
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(memory + offset + i * blockSize);
+        block->next = head;
+        head = block;
+    }
+    return head;
+}
+
+void Heap::releaseUnused() {
+    Cache& cache = local;
+    auto slabOf = [](const FreeBlock* block) {
+        return reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(block) & ~(uintptr_t(SLAB_SIZE) - 1));
+    };
+
+    for (Slab* slab = cache.slabs; slab; slab = slab->next) {
+        slab->freeCount = 0;
+    }
+    for (FreeBlock* list : cache.free) {
+        for (FreeBlock* block = list; block; block = block->next) {
+            ++slabOf(block)->freeCount;
+        }
+    }
+
+    // Unthread the blocks of fully free slabs, keeping the other blocks in order
+    for (FreeBlock*& list : cache.free) {
+        FreeBlock** link = &list;
+        while (*link) {
+            Slab* slab = slabOf(*link);
+            if (slab->freeCount == slab->blockCount) {
+                *link = (*link)->next;
+            } else {
+                link = &(*link)->next;
+            }
+        }
+    }
+
+    Slab** link = &cache.slabs;
+    while (*link) {
+        Slab* slab = *link;
+        if (slab->freeCount == slab->blockCount) {
+            *link = slab->next;
+            ::operator delete(slab, std::align_val_t(SLAB_SIZE));
+        } else {
+            link = &slab->next;
+        }
+    }
+}
+
+void Heap::report(std::ostream& out) {
+    for (size_t k = 0; k < static_cast<size_t>(HeapKind::COUNT); ++k) {
+        out << "heap " << KIND_NAMES[k] << ": live " << local.live[k] << " bytes, peak " << local.peak[k]
+            << " bytes" << std::endl;
+    }
+}
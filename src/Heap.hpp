@@ -0,0 +1,179 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+
+class Expr;
+class Stmt;
+
+/** What a heap block holds, for the live and peak byte counters. */
+enum class HeapKind {
+    ENVIRONMENT,
+    FUNCTION,
+    INSTANCE,
+    AST,
+    COUNT
+};
+
+/**
+ * Size-class slab allocator for the interpreter's heap objects. Requests of
+ * up to MAX_BLOCK bytes are rounded up to a multiple of 16 and served from
+ * 64 KiB slabs carved into blocks of that size; every thread keeps its own
+ * free list per size class, so allocating and freeing are a pointer pop and
+ * push. Larger requests go to operator new. A block must be freed on the
+ * thread that allocated it, which the single-threaded interpreter guarantees.
+ *
+ * Allocate through Heap::make (AST nodes), HeapObject (reference-counted
+ * runtime objects) or HeapAllocator (containers).
+ */
+class Heap {
+public:
+    static constexpr size_t GRANULE = 16;
+    static constexpr size_t MAX_BLOCK = 256;
+    static constexpr size_t SLAB_SIZE = 64 * 1024;
+    static constexpr size_t CLASS_COUNT = MAX_BLOCK / GRANULE;
+
+    struct Stats {
+        size_t live; // Bytes currently allocated
+        size_t peak; // Most bytes allocated at once
+    };
+
+    static void* allocate(size_t bytes, HeapKind kind) {
+        Cache& cache = local;
+        size_t k = static_cast<size_t>(kind);
+        cache.live[k] += bytes;
+        if (cache.live[k] > cache.peak[k]) cache.peak[k] = cache.live[k];
+        if (bytes > MAX_BLOCK) return ::operator new(bytes);
+
+        size_t sizeClass = (bytes - 1) / GRANULE;
+        FreeBlock* block = cache.free[sizeClass];
+        if (!block) block = refill(sizeClass);
+        cache.free[sizeClass] = block->next;
+        return block;
+    }
+
+    static void deallocate(void* pointer, size_t bytes, HeapKind kind) {
+        Cache& cache = local;
+        cache.live[static_cast<size_t>(kind)] -= bytes;
+        if (bytes > MAX_BLOCK) {
+            ::operator delete(pointer);
+            return;
+        }
+        size_t sizeClass = (bytes - 1) / GRANULE;
+        FreeBlock* block = static_cast<FreeBlock*>(pointer);
+        block->next = cache.free[sizeClass];
+        cache.free[sizeClass] = block;
+    }
+
+    /** Construct an AST node in a heap block, with its reference count alongside. */
+    template <typename T, typename... Args>
+    static std::shared_ptr<T> make(Args&&... args);
+
+    /** Give every slab of this thread whose blocks are all free back to the system. */
+    static void releaseUnused();
+
+    static Stats stats(HeapKind kind) {
+        size_t k = static_cast<size_t>(kind);
+        return Stats{local.live[k], local.peak[k]};
+    }
+
+    /** Print the live and peak bytes of every kind, one line each. */
+    static void report(std::ostream& out);
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    /** Header at the start of each slab; its blocks follow. */
+    struct Slab {
+        Slab* next;
+        uint32_t sizeClass;
+        uint32_t blockCount;
+        uint32_t freeCount; // Scratch for releaseUnused
+    };
+
+    /**
+     * A thread's free lists, slabs and counters. Trivially destructible, so
+     * objects destroyed after thread-local teardown (static globals of
+     * compiled programs, for one) can still be freed.
+     */
+    struct Cache {
+        FreeBlock* free[CLASS_COUNT];
+        Slab* slabs;
+        size_t live[static_cast<size_t>(HeapKind::COUNT)];
+        size_t peak[static_cast<size_t>(HeapKind::COUNT)];
+    };
+
+    static constinit inline thread_local Cache local{};
+
+    static FreeBlock* refill(size_t sizeClass);
+};
+
+/** Standard allocator over the Heap, charging every block to Kind. */
+template <typename T, HeapKind Kind>
+class HeapAllocator {
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = HeapAllocator<U, Kind>;
+    };
+
+    HeapAllocator() = default;
+    template <typename U>
+    HeapAllocator(const HeapAllocator<U, Kind>&) {}
+
+    T* allocate(size_t count) {
+        static_assert(alignof(T) <= Heap::GRANULE, "Heap blocks are only 16-byte aligned");
+        return static_cast<T*>(Heap::allocate(count * sizeof(T), Kind));
+    }
+
+    void deallocate(T* pointer, size_t count) {
+        Heap::deallocate(pointer, count * sizeof(T), Kind);
+    }
+
+    template <typename U>
+    bool operator==(const HeapAllocator<U, Kind>&) const { return true; }
+};
+
+template <typename T, typename... Args>
+std::shared_ptr<T> Heap::make(Args&&... args) {
+    static_assert(std::is_base_of_v<Expr, T> || std::is_base_of_v<Stmt, T>, "Runtime objects derive from HeapObject");
+    return std::allocate_shared<T>(HeapAllocator<T, HeapKind::AST>(), std::forward<Args>(args)...);
+}
+
+/**
+ * Base that makes `new` and `delete` of a class use the Heap, charging its
+ * blocks to Kind. Deleting through a virtual destructor passes the size of
+ * the most derived object, so subclasses are freed to the right size class.
+ */
+template <HeapKind Kind>
+class HeapObject {
+public:
+    static void* operator new(size_t bytes) {
+        return Heap::allocate(bytes, Kind);
+    }
+
+    static void operator delete(void* pointer, size_t bytes) {
+        Heap::deallocate(pointer, bytes, Kind);
+    }
+};
+
+/**
+ * Gives the Heap's fully free slabs back when it goes out of scope. The
+ * Interpreter holds one as its first member, so this runs after everything
+ * else it owns has been freed.
+ */
+class HeapScope {
+public:
+    HeapScope() = default;
+    ~HeapScope() { Heap::releaseUnused(); }
+    HeapScope(const HeapScope&) = delete;
+    HeapScope& operator=(const HeapScope&) = delete;
+};
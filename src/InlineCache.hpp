@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+class LoxFunction;
+class Shape;
+
+/**
+ * A small polymorphic inline cache, kept on the AST node (or compiled site)
+ * of a property access. It remembers the outcome of the lookup for up to
+ * MAX_ENTRIES receiver layouts. A site that sees more than that goes
+ * megamorphic and stops caching, since probing would cost more than it
+ * saves. Instances in dictionary mode are never cached.
+ */
+template <typename Entry>
+class InlineCache {
+public:
+    static constexpr size_t MAX_ENTRIES = 4;
+
+    /** The first entry whose key matches, or nullptr. */
+    template <typename Matches>
+    const Entry* find(Matches matches) const {
+        if (megamorphic) return nullptr;
+        for (size_t i = 0; i < count; ++i) {
+            if (matches(entries[i])) return &entries[i];
+        }
+        return nullptr;
+    }
+
+    void add(Entry entry) {
+        if (megamorphic) return;
+        if (count == MAX_ENTRIES) {
+            megamorphic = true;
+            return;
+        }
+        entries[count++] = std::move(entry);
+    }
+
+    bool isMegamorphic() const { return megamorphic; }
+
+private:
+    Entry entries[MAX_ENTRIES];
+    size_t count = 0;
+    bool megamorphic = false;
+};
+
+/** How a property read resolved for one receiver shape and class. */
+struct GetCacheEntry {
+    Shape* shape = nullptr;
+    // LoxClass::getId(), which unlike the class's address is never reused, and
+    // holds no reference, so a cache cannot keep a class and its closures alive
+    uint64_t classId = 0;
+    int slot = -1;                  // The field's slot, or -1 for a method
+    LoxFunction* method = nullptr;  // The class's method, when the shape has no such field; owned by the class
+};
+
+/** How a property write resolved for one receiver shape. */
+struct SetCacheEntry {
+    Shape* shape = nullptr;
+    Shape* next = nullptr; // Shape after the write: the same, or its child when the field is new
+    int slot = -1;
+};
+
+using GetCache = InlineCache<GetCacheEntry>;
+using SetCache = InlineCache<SetCacheEntry>;
@@ -0,0 +1,585 @@
+#include "Jit.hpp"
+#include "interpreter.hpp"
+
+#if LOX_JIT_SUPPORTED
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+
+namespace {
+
+/** Thrown while compiling when a construct is outside the JIT's numeric subset. */
+struct Unsupported {};
+
+/** A jump target. Forward references are patched when the label is bound. */
+struct Label {
+    int position = -1;
+    std::vector<int> patches;
+};
+
+/** Condition codes for Jcc rel32 (second opcode byte). */
+enum Condition : uint8_t {
+    JB = 0x82, JAE = 0x83, JE = 0x84, JNE = 0x85, JBE = 0x86, JA = 0x87, JP = 0x8A, JGE = 0x8D
+};
+
+/**
+ * Minimal x86-64 emitter for the instructions the JIT uses. Doubles live in
+ * xmm0 (result) and xmm1 (right operand); temporaries go on the machine
+ * stack. rbx points at the frame's locals, r13 at the inputs array and r12
+ * at the bail flag, which a function's recursion budget follows.
+ */
+class Assembler {
+public:
+    std::vector<unsigned char> code;
+
+    int size() const { return static_cast<int>(code.size()); }
+
+    void emit(std::initializer_list<uint8_t> bytes) {
+        code.insert(code.end(), bytes.begin(), bytes.end());
+    }
+
+    void emit32(int32_t value) {
+        for (int i = 0; i < 4; ++i) code.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    void emit64(uint64_t value) {
+        for (int i = 0; i < 8; ++i) code.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    void patch32(int at, int32_t value) {
+        for (int i = 0; i < 4; ++i) code[at + i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+
+    void bind(Label& label) {
+        label.position = size();
+        for (int at : label.patches) patch32(at, label.position - (at + 4));
+        label.patches.clear();
+    }
+
+    void jump(Label& label) { emit({0xE9}); target(label); }
+    void jumpIf(Condition condition, Label& label) { emit({0x0F, condition}); target(label); }
+
+    /** movsd xmm0, [base + disp]; base is r13 for inputs, rbx for locals. */
+    void load(bool input, int32_t disp) {
+        if (input) emit({0xF2, 0x41, 0x0F, 0x10, 0x85}); else emit({0xF2, 0x0F, 0x10, 0x83});
+        emit32(disp);
+    }
+
+    /** movsd [base + disp], xmm0 */
+    void store(bool input, int32_t disp) {
+        if (input) emit({0xF2, 0x41, 0x0F, 0x11, 0x85}); else emit({0xF2, 0x0F, 0x11, 0x83});
+        emit32(disp);
+    }
+
+    void loadConstant(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof bits);
+        emit({0x48, 0xB8}); emit64(bits);              // mov rax, imm64
+        emit({0x66, 0x48, 0x0F, 0x6E, 0xC0});          // movq xmm0, rax
+    }
+
+    void negate() {
+        emit({0x48, 0xB8}); emit64(0x8000000000000000ull); // mov rax, sign bit
+        emit({0x66, 0x48, 0x0F, 0x6E, 0xC8});               // movq xmm1, rax
+        emit({0x66, 0x0F, 0x57, 0xC1});                     // xorpd xmm0, xmm1
+    }
+
+    void push() {
+        emit({0x48, 0x83, 0xEC, 0x08});        // sub rsp, 8
+        emit({0xF2, 0x0F, 0x11, 0x04, 0x24});  // movsd [rsp], xmm0
+    }
+
+    void pop() {
+        emit({0xF2, 0x0F, 0x10, 0x04, 0x24});  // movsd xmm0, [rsp]
+        emit({0x48, 0x83, 0xC4, 0x08});        // add rsp, 8
+    }
+
+    /** Move xmm0 to xmm1 and pop the saved left operand into xmm0. */
+    void popLeft() {
+        emit({0x66, 0x0F, 0x28, 0xC8});        // movapd xmm1, xmm0
+        emit({0xF2, 0x0F, 0x10, 0x04, 0x24});  // movsd xmm0, [rsp]
+        emit({0x48, 0x83, 0xC4, 0x08});        // add rsp, 8
+    }
+
+private:
+    void target(Label& label) {
+        if (label.position >= 0) {
+            emit32(label.position - (size() + 4));
+        } else {
+            label.patches.push_back(size());
+            emit32(0);
+        }
+    }
+};
+
+/**
+ * Compiles one function or loop to native code. Every value is a double;
+ * booleans only exist as branches, so anything that would produce another
+ * type throws Unsupported and the unit stays in the tree walker.
+ */
+class UnitCompiler {
+public:
+    struct Location {
+        bool input;
+        int32_t disp;
+    };
+
+    UnitCompiler() = default;
+
+    /** Native code for a function whose body references only its own parameters and locals. */
+    std::vector<unsigned char> compileFunction(const Function& function, bool& callsSelf) {
+        functionName = function.name.getSymbol();
+        arity = static_cast<int>(function.params.size());
+        scopes.emplace_back();
+        for (int i = 0; i < arity; ++i) {
+            // Arguments are pushed left to right, so the first one sits highest
+            scopes.back()[function.params[i].getSymbol()] = Location{true, 8 * (arity - 1 - i)};
+        }
+        prologue();
+        as.bind(bodyLabel);
+        if (auto block = std::dynamic_pointer_cast<Block>(function.body)) {
+            for (const auto& statement : block->statements) compileStmt(*statement);
+        } else {
+            compileStmt(*function.body);
+        }
+        // Falling off the end returns nil, which only the tree walker can represent
+        as.emit({0x41, 0xC7, 0x04, 0x24}); as.emit32(1); // mov dword [r12], 1
+        as.jump(epilogueLabel);
+        epilogue();
+        callsSelf = selfCalls;
+        return std::move(as.code);
+    }
+
+    /** Native code for a loop. Variables from outside it are read and written through the inputs array. */
+    std::vector<unsigned char> compileLoop(const While& loop, std::vector<Jit::LoopInput>& loopInputs) {
+        inLoopUnit = true;
+        prologue();
+        compileStmt(loop);
+        epilogue();
+        loopInputs = std::move(inputs);
+        return std::move(as.code);
+    }
+
+private:
+    void prologue() {
+        as.emit({0x55});                    // push rbp
+        as.emit({0x48, 0x89, 0xE5});        // mov rbp, rsp
+        as.emit({0x53});                    // push rbx
+        as.emit({0x41, 0x54});              // push r12
+        as.emit({0x41, 0x55});              // push r13
+        as.emit({0x48, 0x81, 0xEC});        // sub rsp, imm32 (patched once the locals are known)
+        frameSizeAt = as.size();
+        as.emit32(0);
+        as.emit({0x48, 0x89, 0xE3});        // mov rbx, rsp
+        as.emit({0x49, 0x89, 0xF4});        // mov r12, rsi
+        as.emit({0x49, 0x89, 0xFD});        // mov r13, rdi
+    }
+
+    void epilogue() {
+        as.bind(epilogueLabel);
+        as.emit({0x48, 0x8D, 0x65, 0xE8});  // lea rsp, [rbp - 24]
+        as.emit({0x41, 0x5D});              // pop r13
+        as.emit({0x41, 0x5C});              // pop r12
+        as.emit({0x5B});                    // pop rbx
+        as.emit({0x5D});                    // pop rbp
+        as.emit({0xC3});                    // ret
+        // Four pushes leave rsp 8 bytes off alignment, so reserve an odd number of slots
+        int slots = nextLocal | 1;
+        as.patch32(frameSizeAt, 8 * slots);
+    }
+
+    void compileStmt(const Stmt& stmt) {
+        if (auto expression = dynamic_cast<const Expression*>(&stmt)) {
+            compileExpr(*expression->expression);
+        } else if (auto var = dynamic_cast<const Var*>(&stmt)) {
+            // A loop body without braces would define into the loop's own environment
+            if (!var->initializer || (inLoopUnit && scopes.empty())) throw Unsupported{};
+            compileExpr(*var->initializer);
+            Location location{false, 8 * nextLocal++};
+            as.store(location.input, location.disp);
+            scopes.back()[var->name.getSymbol()] = location;
+        } else if (auto block = dynamic_cast<const Block*>(&stmt)) {
+            scopes.emplace_back();
+            for (const auto& statement : block->statements) compileStmt(*statement);
+            scopes.pop_back();
+        } else if (auto ifStmt = dynamic_cast<const If*>(&stmt)) {
+            Label elseLabel, endLabel;
+            branch(*ifStmt->condition, false, elseLabel);
+            if (ifStmt->thenBranch) compileStmt(*ifStmt->thenBranch);
+            as.jump(endLabel);
+            as.bind(elseLabel);
+            if (ifStmt->elseBranch) compileStmt(*ifStmt->elseBranch);
+            as.bind(endLabel);
+        } else if (auto whileStmt = dynamic_cast<const While*>(&stmt)) {
+            Label top, exit;
+            as.bind(top);
+            branch(*whileStmt->condition, false, exit);
+            compileStmt(*whileStmt->body);
+            as.jump(top);
+            as.bind(exit);
+        } else if (auto returnStmt = dynamic_cast<const Return*>(&stmt)) {
+            if (inLoopUnit || !returnStmt->value) throw Unsupported{};
+            if (returnStmt->tailCall) {
+                compileTailSelfCall(static_cast<const Call&>(*returnStmt->value));
+                return;
+            }
+            compileExpr(*returnStmt->value);
+            as.jump(epilogueLabel);
+        } else {
+            throw Unsupported{};
+        }
+    }
+
+    /** Emit code leaving the expression's value in xmm0. */
+    void compileExpr(const Expr& expr) {
+        if (auto literal = dynamic_cast<const Literal*>(&expr)) {
+            if (!literal->value.isNumber()) throw Unsupported{};
+            as.loadConstant(literal->value.asNumber());
+        } else if (auto grouping = dynamic_cast<const Grouping*>(&expr)) {
+            compileExpr(*grouping->expression);
+        } else if (auto variable = dynamic_cast<const Variable*>(&expr)) {
+            Location location = resolve(variable->local, variable->name, false);
+            as.load(location.input, location.disp);
+        } else if (auto assign = dynamic_cast<const Assign*>(&expr)) {
+            compileExpr(*assign->value);
+            Location location = resolve(assign->local, assign->name, true);
+            as.store(location.input, location.disp);
+        } else if (auto unary = dynamic_cast<const Unary*>(&expr)) {
+            if (unary->op.getTokenType() != TokenType::MINUS) throw Unsupported{};
+            compileExpr(*unary->right);
+            as.negate();
+        } else if (auto binary = dynamic_cast<const Binary*>(&expr)) {
+            uint8_t opcode;
+            switch (binary->op.getTokenType()) {
+                case TokenType::PLUS:  opcode = 0x58; break; // addsd
+                case TokenType::MINUS: opcode = 0x5C; break; // subsd
+                case TokenType::STAR:  opcode = 0x59; break; // mulsd
+                case TokenType::SLASH: opcode = 0x5E; break; // divsd
+                default: throw Unsupported{};
+            }
+            operands(*binary);
+            as.emit({0xF2, 0x0F, opcode, 0xC1});
+        } else if (auto call = dynamic_cast<const Call*>(&expr)) {
+            compileSelfCall(*call);
+        } else {
+            throw Unsupported{};
+        }
+    }
+
+    /** Evaluate both operands: left in xmm0, right in xmm1. */
+    void operands(const Binary& binary) {
+        compileExpr(*binary.left);
+        as.push();
+        depth += 8;
+        compileExpr(*binary.right);
+        as.popLeft();
+        depth -= 8;
+    }
+
+    /** Recursive call through the function's own global name, made directly to its native entry. */
+    void compileSelfCall(const Call& call) {
+        checkSelfCall(call);
+        for (const auto& argument : call.arguments) {
+            compileExpr(*argument);
+            as.push();
+            depth += 8;
+        }
+        // Past the interpreter's call depth the tree walker takes over and reports the overflow
+        Label room;
+        as.emit({0x41, 0x83, 0x6C, 0x24, 0x04, 0x01}); // sub dword [r12 + 4], 1
+        as.jumpIf(JGE, room);
+        as.emit({0x41, 0xC7, 0x04, 0x24}); as.emit32(1); // mov dword [r12], 1
+        as.jump(epilogueLabel);
+        as.bind(room);
+        as.emit({0x48, 0x89, 0xE7});            // mov rdi, rsp
+        as.emit({0x4C, 0x89, 0xE6});            // mov rsi, r12
+        int padding = depth % 16;
+        if (padding) as.emit({0x48, 0x83, 0xEC, 0x08}); // sub rsp, 8
+        as.emit({0xE8});                        // call entry
+        as.emit32(-(as.size() + 4));
+        as.emit({0x48, 0x81, 0xC4});            // add rsp, imm32
+        as.emit32(padding + 8 * arity);
+        depth -= 8 * arity;
+        as.emit({0x41, 0x83, 0x44, 0x24, 0x04, 0x01}); // add dword [r12 + 4], 1
+        as.emit({0x41, 0x83, 0x3C, 0x24, 0x00}); // cmp dword [r12], 0
+        as.jumpIf(JNE, epilogueLabel);           // The callee bailed out; so does every caller
+    }
+
+    /** 'return f(...)' from f itself: the arguments replace the parameters and the body starts over. */
+    void compileTailSelfCall(const Call& call) {
+        checkSelfCall(call);
+        for (const auto& argument : call.arguments) {
+            compileExpr(*argument);
+            as.push();
+            depth += 8;
+        }
+        for (int i = arity - 1; i >= 0; --i) {
+            as.pop();
+            depth -= 8;
+            as.store(true, 8 * (arity - 1 - i));
+        }
+        as.jump(bodyLabel);
+    }
+
+    void checkSelfCall(const Call& call) {
+        auto callee = dynamic_cast<const Variable*>(call.callee.get());
+        if (inLoopUnit || !callee || callee->name.getSymbol() != functionName ||
+            !callee->local.isGlobal() || lookup(functionName) ||
+            static_cast<int>(call.arguments.size()) != arity) {
+            throw Unsupported{};
+        }
+        selfCalls = true;
+    }
+
+    /** Jump to target if the condition's truthiness equals jumpIf, otherwise fall through. */
+    void branch(const Expr& expr, bool jumpIf, Label& target) {
+        if (auto grouping = dynamic_cast<const Grouping*>(&expr)) {
+            branch(*grouping->expression, jumpIf, target);
+        } else if (auto literal = dynamic_cast<const Literal*>(&expr)) {
+            if (isTruthy(literal->value) == jumpIf) as.jump(target);
+        } else if (auto unary = dynamic_cast<const Unary*>(&expr); unary && unary->op.getTokenType() == TokenType::BANG) {
+            branch(*unary->right, !jumpIf, target);
+        } else if (auto logical = dynamic_cast<const Logical*>(&expr)) {
+            bool isAnd = logical->op.getTokenType() == TokenType::AND;
+            if (isAnd != jumpIf) {
+                // 'a and b' is false if either is false; 'a or b' is true if either is true
+                branch(*logical->left, jumpIf, target);
+                branch(*logical->right, jumpIf, target);
+            } else {
+                Label skip;
+                branch(*logical->left, !jumpIf, skip);
+                branch(*logical->right, jumpIf, target);
+                as.bind(skip);
+            }
+        } else if (auto binary = dynamic_cast<const Binary*>(&expr); binary && isComparison(binary->op.getTokenType())) {
+            compare(*binary, jumpIf, target);
+        } else {
+            // Every number is truthy
+            compileExpr(expr);
+            if (jumpIf) as.jump(target);
+        }
+    }
+
+    static bool isComparison(TokenType type) {
+        switch (type) {
+            case TokenType::GREATER: case TokenType::GREATER_EQUAL:
+            case TokenType::LESS: case TokenType::LESS_EQUAL:
+            case TokenType::EQUAL_EQUAL: case TokenType::BANG_EQUAL:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /** ucomisd sets CF and ZF (and PF when unordered), so NaN compares false like in the tree walker. */
+    void compare(const Binary& binary, bool jumpIf, Label& target) {
+        operands(binary);
+        TokenType type = binary.op.getTokenType();
+        if (type == TokenType::LESS || type == TokenType::LESS_EQUAL) {
+            as.emit({0x66, 0x0F, 0x2E, 0xC8});  // ucomisd xmm1, xmm0
+        } else {
+            as.emit({0x66, 0x0F, 0x2E, 0xC1});  // ucomisd xmm0, xmm1
+        }
+        switch (type) {
+            case TokenType::GREATER:
+            case TokenType::LESS:
+                as.jumpIf(jumpIf ? JA : JBE, target);
+                break;
+            case TokenType::GREATER_EQUAL:
+            case TokenType::LESS_EQUAL:
+                as.jumpIf(jumpIf ? JAE : JB, target);
+                break;
+            case TokenType::EQUAL_EQUAL:
+            case TokenType::BANG_EQUAL: {
+                // Equal means ZF set with PF clear
+                bool jumpIfEqual = (type == TokenType::EQUAL_EQUAL) == jumpIf;
+                if (jumpIfEqual) {
+                    Label skip;
+                    as.jumpIf(JP, skip);
+                    as.jumpIf(JE, target);
+                    as.bind(skip);
+                } else {
+                    as.jumpIf(JP, target);
+                    as.jumpIf(JNE, target);
+                }
+                break;
+            }
+            default:
+                throw Unsupported{};
+        }
+    }
+
+    const Location* lookup(SymbolId name) const {
+        for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+            auto it = scope->find(name);
+            if (it != scope->end()) return &it->second;
+        }
+        return nullptr;
+    }
+
+    /**
+     * Where a variable lives. Functions only see their own scopes; loops also
+     * reach outer variables, which become inputs identified by the resolver's
+     * distance measured from the loop's environment.
+     */
+    Location resolve(const LocalSlot& local, const Token& name, bool write) {
+        if (const Location* location = lookup(name.getSymbol())) return *location;
+        if (!inLoopUnit) throw Unsupported{};
+
+        int hops = -1;
+        if (!local.isGlobal()) {
+            hops = local.depth - static_cast<int>(scopes.size());
+            if (hops < 0) throw Unsupported{};
+        }
+        int slot = local.slot;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            bool same = hops < 0 ? inputs[i].name.getSymbol() == name.getSymbol() : inputs[i].slot == slot;
+            if (inputs[i].hops == hops && same) {
+                inputs[i].written = inputs[i].written || write;
+                return Location{true, static_cast<int32_t>(8 * i)};
+            }
+        }
+        inputs.push_back(Jit::LoopInput{hops, slot, name, write});
+        return Location{true, static_cast<int32_t>(8 * (inputs.size() - 1))};
+    }
+
+    Assembler as;
+    Label epilogueLabel;
+    Label bodyLabel;
+    int frameSizeAt = 0;
+    int nextLocal = 0;
+    int depth = 0; // Bytes of temporaries on the machine stack
+    std::vector<std::unordered_map<SymbolId, Location>> scopes;
+    std::vector<Jit::LoopInput> inputs;
+    SymbolId functionName = 0;
+    int arity = 0;
+    bool inLoopUnit = false;
+    bool selfCalls = false;
+};
+
+} // namespace
+
+Jit::~Jit() {
+    for (const auto& mapping : mappings) {
+        munmap(mapping.first, mapping.second);
+    }
+}
+
+Jit::NativeCode Jit::install(const std::vector<unsigned char>& code) {
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t length = (code.size() + page - 1) / page * page;
+    void* memory = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return nullptr;
+    std::memcpy(memory, code.data(), code.size());
+    if (mprotect(memory, length, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, length);
+        return nullptr;
+    }
+    mappings.emplace_back(memory, length);
+    return reinterpret_cast<NativeCode>(memory);
+}
+
+bool Jit::tryCall(Interpreter& interpreter, const LoxFunction& function,
+                  const std::vector<lox_literal>& arguments, lox_literal& result) {
+    const Function& declaration = function.getDeclaration();
+    FunctionState& state = functions[declaration.body.get()];
+    if (state.status == Status::COUNTING) {
+        if (++state.count < HOT_CALL_THRESHOLD) return false;
+        state.status = Status::FAILED;
+        try {
+            UnitCompiler compiler;
+            state.code = install(compiler.compileFunction(declaration, state.callsSelf));
+            if (state.code) state.status = Status::COMPILED;
+        } catch (const Unsupported&) {
+        }
+    }
+    if (state.status != Status::COMPILED) return false;
+
+    // Recursive calls jump straight to this code, so the global name must still mean this function
+    if (state.callsSelf) {
+        SymbolId name = declaration.name.getSymbol();
+        if (!interpreter.globals->has(name)) return false;
+        const lox_literal& global = interpreter.globals->get(name);
+        if (!global.isCallable() || global.asCallable() != &function) return false;
+    }
+
+    std::vector<double> inputs(arguments.size());
+    for (size_t i = 0; i < arguments.size(); ++i) {
+        if (!arguments[i].isNumber()) return false;
+        inputs[arguments.size() - 1 - i] = arguments[i].asNumber();
+    }
+    // The bail flag, then how many more calls may nest
+    size_t callsLeft = interpreter.maxCallDepth - interpreter.callDepth;
+    int status[2] = {0, static_cast<int>(std::min<size_t>(callsLeft, INT_MAX))};
+    double value = state.code(inputs.data(), status);
+    if (status[0]) {
+        if (++state.bails > MAX_BAILS) state.status = Status::FAILED;
+        return false;
+    }
+    result = value;
+    return true;
+}
+
+bool Jit::onBackEdge(Interpreter& interpreter, const While& loop) {
+    LoopState& state = loops[&loop];
+    if (state.status == Status::COUNTING) {
+        if (++state.count < HOT_LOOP_THRESHOLD) return false;
+        state.status = Status::FAILED;
+        try {
+            UnitCompiler compiler;
+            state.code = install(compiler.compileLoop(loop, state.inputs));
+            if (state.code) state.status = Status::COMPILED;
+        } catch (const Unsupported&) {
+        }
+    }
+    if (state.status != Status::COMPILED) return false;
+
+    std::vector<Ref<Environment>> environments(state.inputs.size());
+    std::vector<double> values(state.inputs.size());
+    for (size_t i = 0; i < state.inputs.size(); ++i) {
+        const LoopInput& input = state.inputs[i];
+        SymbolId name = input.name.getSymbol();
+        auto environment = input.hops < 0 ? interpreter.globals : interpreter.environment->ancestor(input.hops);
+        if (!environment || (input.hops < 0 && !environment->has(name))) return false;
+        const lox_literal& value = input.hops < 0 ? environment->get(name) : environment->getSlot(input.slot);
+        if (!value.isNumber()) return false;
+        environments[i] = std::move(environment);
+        values[i] = value.asNumber();
+    }
+
+    int bail = 0;
+    state.code(values.data(), &bail);
+
+    for (size_t i = 0; i < state.inputs.size(); ++i) {
+        const LoopInput& input = state.inputs[i];
+        if (!input.written) continue;
+        if (input.hops < 0) {
+            environments[i]->define(input.name.getSymbol(), values[i]);
+        } else {
+            environments[i]->setSlot(input.slot, values[i]);
+        }
+    }
+    return true;
+}
+
+#else
+
+Jit::~Jit() = default;
+
+Jit::NativeCode Jit::install(const std::vector<unsigned char>&) {
+    return nullptr;
+}
+
+bool Jit::tryCall(Interpreter&, const LoxFunction&, const std::vector<lox_literal>&, lox_literal&) {
+    return false;
+}
+
+bool Jit::onBackEdge(Interpreter&, const While&) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "literal.hpp"
+#include "token.hpp"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define LOX_JIT_SUPPORTED 1
+#else
+#define LOX_JIT_SUPPORTED 0
+#endif
+
+class Interpreter;
+class LoxFunction;
+class Stmt;
+class While;
+
+/**
+ * Baseline x86-64 JIT for the tree-walking engines. Calls into LoxFunction
+ * and loop back-edges are counted; once a function or loop is hot, it is
+ * compiled to native code in an mmap'd executable buffer, provided it sticks
+ * to plain numeric code (number locals, arithmetic, comparisons, if/while/
+ * return and calls to itself by its global name; one in tail position
+ * loops back to the start of the body). Anything else, including arguments
+ * or variables that are not numbers at entry, keeps running in the tree
+ * walker. Compiled code has no side effects besides writing its own
+ * variables, so a function that has to bail out is simply re-run by the
+ * tree walker. On other platforms every request falls back.
+ */
+class Jit {
+public:
+    /**
+     * Native entry point: inputs are a function's arguments or a loop's
+     * outer variables. bail is set to 1 if the code bails out; for a
+     * function it is followed by the number of recursive calls that may nest.
+     */
+    using NativeCode = double (*)(double* inputs, int* bail);
+
+    Jit() = default;
+    ~Jit();
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+
+    static bool isSupported() { return LOX_JIT_SUPPORTED; }
+
+    /**
+     * Count a call to an unbound function and run it natively if it is hot
+     * and compiled. Returns false if the caller must run it in the tree walker.
+     */
+    bool tryCall(Interpreter& interpreter, const LoxFunction& function,
+                 const std::vector<lox_literal>& arguments, lox_literal& result);
+
+    /**
+     * Count a back-edge of a while loop. Once the loop is hot and compiled,
+     * runs the remaining iterations natively and returns true.
+     */
+    bool onBackEdge(Interpreter& interpreter, const While& loop);
+
+    /** How many calls or back-edges make a function or loop hot. */
+    static constexpr int HOT_CALL_THRESHOLD = 1000;
+    static constexpr int HOT_LOOP_THRESHOLD = 1000;
+
+    /** A variable from outside a compiled loop, copied in at entry and out at exit. */
+    struct LoopInput {
+        int hops;       // Environments above the loop's; -1 for a global
+        int slot;       // Slot in that environment; globals are found by name
+        Token name;
+        bool written = false;
+    };
+
+private:
+    enum class Status { COUNTING, COMPILED, FAILED };
+
+    struct FunctionState {
+        Status status = Status::COUNTING;
+        int count = 0;
+        int bails = 0;
+        NativeCode code = nullptr;
+        bool callsSelf = false;
+    };
+
+    struct LoopState {
+        Status status = Status::COUNTING;
+        int count = 0;
+        NativeCode code = nullptr;
+        std::vector<LoopInput> inputs;
+    };
+
+    static constexpr int MAX_BAILS = 100;
+
+    /** Copy assembled code into a fresh executable mapping. Returns nullptr on failure. */
+    NativeCode install(const std::vector<unsigned char>& code);
+
+    std::unordered_map<const Stmt*, FunctionState> functions; // Keyed by the function's body
+    std::unordered_map<const While*, LoopState> loops;
+    std::vector<std::pair<void*, size_t>> mappings;
+};
@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <unordered_set>
+#include "LoopTracer.hpp"
+#include "interpreter.hpp"
+
+namespace {
+
+using OpCode = LoopTracer::OpCode;
+
+/** Thrown while recording when the iteration leaves what a trace can express. */
+struct Abort {};
+
+inline double number(const lox_literal& value) {
+    return value.asNumber();
+}
+
+/**
+ * Records one iteration of a loop into a trace. The iteration is evaluated
+ * on the trace's registers as it is recorded, so branch directions and
+ * operand types are the concrete ones; nothing is written back, and the
+ * trace itself then re-runs the iteration from the start.
+ */
+class TraceRecorder {
+public:
+    TraceRecorder(Ref<Environment> environment, Ref<Environment> globals, LoopTracer::Trace& trace)
+        : environment(std::move(environment)), globals(std::move(globals)), trace(trace) {}
+
+    void record(const While& loop) {
+        uint16_t condition = expr(*loop.condition);
+        if (!isTruthy(trace.registers[condition])) throw Abort{};
+        emit({OpCode::EXIT_IF_FALSEY, 0, condition, 0});
+        stmt(*loop.body);
+
+        // Deferred effects: prints in program order, then variable stores
+        for (const auto& print : prints) {
+            trace.ops.push_back(print);
+        }
+        for (size_t i = 0; i < trace.slots.size(); ++i) {
+            LoopTracer::Slot& slot = trace.slots[i];
+            if (current[i] == slot.reg) continue;
+            // The next iteration must see the types this one was specialized for
+            if (trace.registers[current[i]].type() != slot.type) throw Abort{};
+            slot.written = true;
+            // A temporary read by this store alone is recomputed before its next use, so it can be moved
+            bool move = !constants.contains(current[i]) && std::count(current.begin(), current.end(), current[i]) == 1;
+            trace.ops.push_back({OpCode::STORE, slot.reg, current[i], move});
+        }
+    }
+
+private:
+    uint16_t newRegister(lox_literal value) {
+        if (trace.registers.size() >= UINT16_MAX) throw Abort{};
+        trace.registers.push_back(std::move(value));
+        return static_cast<uint16_t>(trace.registers.size() - 1);
+    }
+
+    /** Append an op and run it right away, so later ops see its concrete result. */
+    uint16_t emit(LoopTracer::Op op) {
+        std::vector<lox_literal>& r = trace.registers;
+        switch (op.code) {
+            case OpCode::ADD_NUMBER: r[op.dst] = Value::add(r[op.a], r[op.b]); break;
+            case OpCode::SUBTRACT_NUMBER: r[op.dst] = Value::subtract(r[op.a], r[op.b]); break;
+            case OpCode::MULTIPLY_NUMBER: r[op.dst] = Value::multiply(r[op.a], r[op.b]); break;
+            case OpCode::DIVIDE_NUMBER: r[op.dst] = Value::divide(r[op.a], r[op.b]); break;
+            case OpCode::NEGATE_NUMBER: r[op.dst] = Value::negate(r[op.a]); break;
+            case OpCode::CONCAT: r[op.dst] = Value::adopt(LoxString::concat(r[op.a].asLoxString(), r[op.b].asLoxString())); break;
+            case OpCode::GREATER_NUMBER: r[op.dst] = number(r[op.a]) > number(r[op.b]); break;
+            case OpCode::GREATER_EQUAL_NUMBER: r[op.dst] = number(r[op.a]) >= number(r[op.b]); break;
+            case OpCode::LESS_NUMBER: r[op.dst] = number(r[op.a]) < number(r[op.b]); break;
+            case OpCode::LESS_EQUAL_NUMBER: r[op.dst] = number(r[op.a]) <= number(r[op.b]); break;
+            case OpCode::EQUAL_NUMBER: r[op.dst] = number(r[op.a]) == number(r[op.b]); break;
+            case OpCode::NOT_EQUAL_NUMBER: r[op.dst] = number(r[op.a]) != number(r[op.b]); break;
+            case OpCode::EQUAL: r[op.dst] = r[op.a] == r[op.b]; break;
+            case OpCode::NOT_EQUAL: r[op.dst] = r[op.a] != r[op.b]; break;
+            case OpCode::NOT: r[op.dst] = !isTruthy(r[op.a]); break;
+            case OpCode::MOVE: r[op.dst] = r[op.a]; break;
+            default: break; // Guards hold by construction; effects are deferred
+        }
+        trace.ops.push_back(op);
+        return op.dst;
+    }
+
+    /** A register whose value the trace never recomputes: a literal, a nil default or a slot. */
+    uint16_t constant(lox_literal value) {
+        uint16_t reg = newRegister(std::move(value));
+        constants.insert(reg);
+        return reg;
+    }
+
+    uint16_t binary(OpCode code, uint16_t a, uint16_t b) {
+        return emit({code, newRegister(std::monostate{}), a, b});
+    }
+
+    /** Emit a guard that holds for the value just computed. */
+    void guard(uint16_t value) {
+        emit({isTruthy(trace.registers[value]) ? OpCode::GUARD_TRUTHY : OpCode::GUARD_FALSEY, 0, value, 0});
+    }
+
+    void stmt(const Stmt& stmt) {
+        if (auto expression = dynamic_cast<const Expression*>(&stmt)) {
+            expr(*expression->expression);
+        } else if (auto print = dynamic_cast<const Print*>(&stmt)) {
+            prints.push_back({OpCode::PRINT, 0, expr(*print->expression), 0});
+        } else if (auto var = dynamic_cast<const Var*>(&stmt)) {
+            // A loop body without braces would define into the loop's own environment
+            if (scopes.empty()) throw Abort{};
+            uint16_t value = var->initializer ? expr(*var->initializer) : constant(std::monostate{});
+            scopes.back()[var->name.getSymbol()] = value;
+        } else if (auto block = dynamic_cast<const Block*>(&stmt)) {
+            scopes.emplace_back();
+            for (const auto& statement : block->statements) this->stmt(*statement);
+            scopes.pop_back();
+        } else if (auto ifStmt = dynamic_cast<const If*>(&stmt)) {
+            uint16_t condition = expr(*ifStmt->condition);
+            guard(condition);
+            if (isTruthy(trace.registers[condition])) {
+                if (ifStmt->thenBranch) this->stmt(*ifStmt->thenBranch);
+            } else if (ifStmt->elseBranch) {
+                this->stmt(*ifStmt->elseBranch);
+            }
+        } else {
+            throw Abort{};
+        }
+    }
+
+    uint16_t expr(const Expr& expr) {
+        if (auto literal = dynamic_cast<const Literal*>(&expr)) {
+            return constant(literal->value);
+        } else if (auto grouping = dynamic_cast<const Grouping*>(&expr)) {
+            return this->expr(*grouping->expression);
+        } else if (auto variable = dynamic_cast<const Variable*>(&expr)) {
+            return read(variable->local, variable->name);
+        } else if (auto assign = dynamic_cast<const Assign*>(&expr)) {
+            uint16_t value = this->expr(*assign->value);
+            write(assign->local, assign->name, value);
+            return value;
+        } else if (auto unary = dynamic_cast<const Unary*>(&expr)) {
+            uint16_t right = this->expr(*unary->right);
+            if (unary->op.getTokenType() == TokenType::BANG) {
+                return emit({OpCode::NOT, newRegister(std::monostate{}), right, 0});
+            }
+            if (!trace.registers[right].isNumber()) throw Abort{};
+            return emit({OpCode::NEGATE_NUMBER, newRegister(std::monostate{}), right, 0});
+        } else if (auto logical = dynamic_cast<const Logical*>(&expr)) {
+            uint16_t left = this->expr(*logical->left);
+            guard(left);
+            bool isOr = logical->op.getTokenType() == TokenType::OR;
+            if (isTruthy(trace.registers[left]) == isOr) return left;
+            return this->expr(*logical->right);
+        } else if (auto binary = dynamic_cast<const Binary*>(&expr)) {
+            uint16_t left = this->expr(*binary->left);
+            uint16_t right = this->expr(*binary->right);
+            return binaryOp(binary->op.getTokenType(), left, right);
+        }
+        throw Abort{};
+    }
+
+    /** Pick the op specialized for the operand types; combinations that would raise an error abort. */
+    uint16_t binaryOp(TokenType type, uint16_t left, uint16_t right) {
+        const lox_literal& a = trace.registers[left];
+        const lox_literal& b = trace.registers[right];
+        bool numbers = a.isNumber() && b.isNumber();
+        switch (type) {
+            case TokenType::EQUAL_EQUAL:
+                return binary(numbers ? OpCode::EQUAL_NUMBER : OpCode::EQUAL, left, right);
+            case TokenType::BANG_EQUAL:
+                return binary(numbers ? OpCode::NOT_EQUAL_NUMBER : OpCode::NOT_EQUAL, left, right);
+            case TokenType::PLUS:
+                if (a.isString() && b.isString()) {
+                    return binary(OpCode::CONCAT, left, right);
+                }
+                break;
+            default:
+                break;
+        }
+        if (!numbers) throw Abort{};
+        switch (type) {
+            case TokenType::PLUS: return binary(OpCode::ADD_NUMBER, left, right);
+            case TokenType::MINUS: return binary(OpCode::SUBTRACT_NUMBER, left, right);
+            case TokenType::STAR: return binary(OpCode::MULTIPLY_NUMBER, left, right);
+            case TokenType::SLASH: return binary(OpCode::DIVIDE_NUMBER, left, right);
+            case TokenType::GREATER: return binary(OpCode::GREATER_NUMBER, left, right);
+            case TokenType::GREATER_EQUAL: return binary(OpCode::GREATER_EQUAL_NUMBER, left, right);
+            case TokenType::LESS: return binary(OpCode::LESS_NUMBER, left, right);
+            case TokenType::LESS_EQUAL: return binary(OpCode::LESS_EQUAL_NUMBER, left, right);
+            default: throw Abort{};
+        }
+    }
+
+    const uint16_t* lookupLocal(SymbolId name) const {
+        for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+            auto it = scope->find(name);
+            if (it != scope->end()) return &it->second;
+        }
+        return nullptr;
+    }
+
+    uint16_t read(const LocalSlot& local, const Token& name) {
+        if (const uint16_t* reg = lookupLocal(name.getSymbol())) return *reg;
+        return current[slot(local, name)];
+    }
+
+    void write(const LocalSlot& local, const Token& name, uint16_t value) {
+        SymbolId key = name.getSymbol();
+        for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+            auto it = scope->find(key);
+            if (it != scope->end()) {
+                it->second = value;
+                return;
+            }
+        }
+        size_t index = slot(local, name);
+        // Stores run in sequence at the end of the iteration, so never store straight from another slot
+        bool fromSlot = false;
+        for (const auto& other : trace.slots) fromSlot = fromSlot || other.reg == value;
+        if (fromSlot) value = emit({OpCode::MOVE, newRegister(std::monostate{}), value, 0});
+        current[index] = value;
+    }
+
+    /** The slot for a variable from outside the loop, loading it on first use. */
+    size_t slot(const LocalSlot& local, const Token& name) {
+        int hops = -1;
+        if (!local.isGlobal()) {
+            hops = local.depth - static_cast<int>(scopes.size());
+            if (hops < 0) throw Abort{};
+        }
+        int index = local.slot;
+        for (size_t i = 0; i < trace.slots.size(); ++i) {
+            const LoopTracer::Slot& slot = trace.slots[i];
+            bool same = hops < 0 ? slot.name.getSymbol() == name.getSymbol() : slot.index == index;
+            if (slot.hops == hops && same) return i;
+        }
+
+        auto scope = hops < 0 ? globals : environment->ancestor(hops);
+        if (!scope || (hops < 0 && !scope->has(name.getSymbol()))) throw Abort{};
+        lox_literal value = hops < 0 ? scope->get(name.getSymbol()) : scope->getSlot(index);
+        if (value.isCallable() || value.isInstance()) {
+            throw Abort{};
+        }
+        Value::Type type = value.type();
+        uint16_t reg = constant(std::move(value));
+        trace.slots.push_back(LoopTracer::Slot{hops, index, name, reg, type});
+        current.push_back(reg);
+        return trace.slots.size() - 1;
+    }
+
+    Ref<Environment> environment; // The loop's environment, outside its body
+    Ref<Environment> globals;
+    LoopTracer::Trace& trace;
+    std::vector<std::unordered_map<SymbolId, uint16_t>> scopes;
+    std::vector<uint16_t> current; // Register holding each slot's latest value this iteration
+    std::vector<LoopTracer::Op> prints;
+    std::unordered_set<uint16_t> constants;
+};
+
+} // namespace
+
+bool LoopTracer::onBackEdge(Interpreter& interpreter, const While& loop) {
+    LoopState& state = loops[&loop];
+    if (state.status == Status::COUNTING) {
+        if (++state.count < HOT_LOOP_THRESHOLD) return false;
+        state.count = 0;
+        auto trace = std::make_unique<Trace>();
+        try {
+            TraceRecorder(interpreter.environment, interpreter.globals, *trace).record(loop);
+        } catch (const Abort&) {
+            if (++state.attempts >= MAX_ATTEMPTS) state.status = Status::FAILED;
+            return false;
+        }
+        state.trace = std::move(trace);
+        state.status = Status::TRACED;
+        state.sideExits = 0;
+    }
+    if (state.status != Status::TRACED) return false;
+
+    if (run(interpreter, *state.trace) == Exit::LOOP_DONE) return true;
+
+    // A trace that keeps exiting early recorded an uncommon path; record a new one later
+    if (++state.sideExits > MAX_SIDE_EXITS) {
+        state.trace.reset();
+        state.status = ++state.attempts >= MAX_ATTEMPTS ? Status::FAILED : Status::COUNTING;
+    }
+    return false;
+}
+
+LoopTracer::Exit LoopTracer::run(Interpreter& interpreter, Trace& trace) {
+    std::vector<lox_literal> r = trace.registers;
+    std::vector<Ref<Environment>> environments(trace.slots.size());
+    for (size_t i = 0; i < trace.slots.size(); ++i) {
+        const Slot& slot = trace.slots[i];
+        SymbolId name = slot.name.getSymbol();
+        auto environment = slot.hops < 0 ? interpreter.globals : interpreter.environment->ancestor(slot.hops);
+        if (!environment || (slot.hops < 0 && !environment->has(name))) return Exit::ENTRY_FAILED;
+        lox_literal value = slot.hops < 0 ? environment->get(name) : environment->getSlot(slot.index);
+        if (value.type() != slot.type) return Exit::ENTRY_FAILED;
+        r[slot.reg] = std::move(value);
+        environments[i] = std::move(environment);
+    }
+
+    Exit exit;
+    for (;;) {
+        for (const Op& op : trace.ops) {
+            switch (op.code) {
+                case OpCode::ADD_NUMBER: r[op.dst] = Value::add(r[op.a], r[op.b]); break;
+                case OpCode::SUBTRACT_NUMBER: r[op.dst] = Value::subtract(r[op.a], r[op.b]); break;
+                case OpCode::MULTIPLY_NUMBER: r[op.dst] = Value::multiply(r[op.a], r[op.b]); break;
+                case OpCode::DIVIDE_NUMBER: r[op.dst] = Value::divide(r[op.a], r[op.b]); break;
+                case OpCode::NEGATE_NUMBER: r[op.dst] = Value::negate(r[op.a]); break;
+                case OpCode::CONCAT: r[op.dst] = Value::adopt(LoxString::concat(r[op.a].asLoxString(), r[op.b].asLoxString())); break;
+                case OpCode::GREATER_NUMBER: r[op.dst] = number(r[op.a]) > number(r[op.b]); break;
+                case OpCode::GREATER_EQUAL_NUMBER: r[op.dst] = number(r[op.a]) >= number(r[op.b]); break;
+                case OpCode::LESS_NUMBER: r[op.dst] = number(r[op.a]) < number(r[op.b]); break;
+                case OpCode::LESS_EQUAL_NUMBER: r[op.dst] = number(r[op.a]) <= number(r[op.b]); break;
+                case OpCode::EQUAL_NUMBER: r[op.dst] = number(r[op.a]) == number(r[op.b]); break;
+                case OpCode::NOT_EQUAL_NUMBER: r[op.dst] = number(r[op.a]) != number(r[op.b]); break;
+                case OpCode::EQUAL: r[op.dst] = r[op.a] == r[op.b]; break;
+                case OpCode::NOT_EQUAL: r[op.dst] = r[op.a] != r[op.b]; break;
+                case OpCode::NOT: r[op.dst] = !isTruthy(r[op.a]); break;
+                case OpCode::MOVE: r[op.dst] = r[op.a]; break;
+                case OpCode::GUARD_TRUTHY:
+                    if (!isTruthy(r[op.a])) { exit = Exit::SIDE_EXIT; goto done; }
+                    break;
+                case OpCode::GUARD_FALSEY:
+                    if (isTruthy(r[op.a])) { exit = Exit::SIDE_EXIT; goto done; }
+                    break;
+                case OpCode::EXIT_IF_FALSEY:
+                    if (!isTruthy(r[op.a])) { exit = Exit::LOOP_DONE; goto done; }
+                    break;
+                case OpCode::PRINT:
+                    std::cout << literal_to_string(r[op.a]) << std::endl;
+                    break;
+                case OpCode::STORE:
+                    if (op.b) {
+                        r[op.dst] = std::move(r[op.a]);
+                    } else {
+                        r[op.dst] = r[op.a];
+                    }
+                    break;
+            }
+        }
+    }
+
+done:
+    for (size_t i = 0; i < trace.slots.size(); ++i) {
+        const Slot& slot = trace.slots[i];
+        if (!slot.written) continue;
+        if (slot.hops < 0) {
+            environments[i]->define(slot.name.getSymbol(), r[slot.reg]);
+        } else {
+            environments[i]->setSlot(slot.index, r[slot.reg]);
+        }
+    }
+    return exit;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "literal.hpp"
+#include "token.hpp"
+
+class Environment;
+class Interpreter;
+class While;
+
+/**
+ * Tracing tier for hot while loops (including desugared for loops). Once a
+ * loop passes the back-edge threshold, one iteration is recorded: the
+ * concrete path through if/and/or becomes guards and every operation is
+ * specialized to the operand types seen. The resulting linear trace then
+ * runs the loop on a register file until the condition is false or a guard
+ * fails.
+ *
+ * Variable stores and prints are deferred to the end of each iteration, so
+ * a failing guard leaves nothing half done: the variables are written back
+ * and the tree walker re-runs that iteration. Loops that call functions,
+ * touch properties, nest other loops or change a variable's type are left
+ * to the tree walker.
+ */
+class LoopTracer {
+public:
+    LoopTracer() = default;
+    LoopTracer(const LoopTracer&) = delete;
+    LoopTracer& operator=(const LoopTracer&) = delete;
+
+    /**
+     * Count a back-edge of a while loop, recording a trace once it is hot.
+     * Returns true if the rest of the loop ran on the trace.
+     */
+    bool onBackEdge(Interpreter& interpreter, const While& loop);
+
+    static constexpr int HOT_LOOP_THRESHOLD = 1000;
+
+    enum class OpCode : uint8_t {
+        ADD_NUMBER, SUBTRACT_NUMBER, MULTIPLY_NUMBER, DIVIDE_NUMBER, NEGATE_NUMBER,
+        CONCAT,
+        GREATER_NUMBER, GREATER_EQUAL_NUMBER, LESS_NUMBER, LESS_EQUAL_NUMBER,
+        EQUAL_NUMBER, NOT_EQUAL_NUMBER, EQUAL, NOT_EQUAL,
+        NOT, MOVE,
+        GUARD_TRUTHY, GUARD_FALSEY, // Side exit if the recorded branch is not taken
+        EXIT_IF_FALSEY,             // The loop condition: leave the loop normally
+        PRINT, STORE                // Deferred effects, run once the iteration completes
+    };
+
+    struct Op {
+        OpCode code;
+        uint16_t dst;
+        uint16_t a;
+        uint16_t b;       // For STORE: nonzero if the source may be moved from
+    };
+
+    /** A variable from outside the loop, held in a register while the trace runs. */
+    struct Slot {
+        int hops;         // Environments above the loop's; -1 for a global
+        int index;        // Slot in that environment; globals are found by name
+        Token name;
+        uint16_t reg;
+        Value::Type type; // Type seen when recorded
+        bool written = false;
+    };
+
+    struct Trace {
+        std::vector<Op> ops;
+        std::vector<Slot> slots;
+        std::vector<lox_literal> registers; // Initial register file, constants included
+    };
+
+private:
+    enum class Status { COUNTING, TRACED, FAILED };
+
+    struct LoopState {
+        Status status = Status::COUNTING;
+        int count = 0;
+        int attempts = 0;
+        int sideExits = 0;
+        std::unique_ptr<Trace> trace;
+    };
+
+    static constexpr int MAX_ATTEMPTS = 3;
+    static constexpr int MAX_SIDE_EXITS = 10;
+
+    /** Result of running a trace from a back-edge. */
+    enum class Exit { LOOP_DONE, SIDE_EXIT, ENTRY_FAILED };
+
+    Exit run(Interpreter& interpreter, Trace& trace);
+
+    std::unordered_map<const While*, LoopState> loops;
+};
@@ -3,13 +3,18 @@
 #include "token.hpp"
 #include "Environment.hpp"
 #include "literal.hpp"
+#include "Ref.hpp"
 
 class Interpreter; // Forward declaration
 
-class LoxCallable {
+class LoxCallable : public RefCounted {
 public:
     virtual ~LoxCallable() {} // Ensure proper cleanup of derived classes
     virtual size_t arity() const = 0;
     virtual lox_literal call(Interpreter& interpreter, const std::vector<lox_literal>& arguments) = 0;
     virtual std::string toString() const = 0;
-};
\ No newline at end of file
+};
+
+inline LoxCallable* Value::asCallable() const {
+    return static_cast<LoxCallable*>(asObject());
+}
\ No newline at end of file
@@ -1,14 +1,12 @@
 #include "LoxClass.hpp"
 #include "LoxInstance.hpp"
+#include "interpreter.hpp"
 
 lox_literal LoxClass::call(Interpreter& interpreter, const std::vector<lox_literal>& arguments) {
-    auto instance = LoxInstance::create(std::static_pointer_cast<LoxClass>(shared_from_this()));
-    auto initializer = findMethod("init");
+    interpreter.collectGarbageIfNeeded();
+    auto instance = LoxInstance::create(Ref<LoxClass>(this));
     if (initializer) {
-        auto initFunc = std::dynamic_pointer_cast<LoxFunction>(initializer);
-        if (initFunc) {
-            initFunc->bind(instance)->call(interpreter, arguments);
-        }
+        initializer->callMethod(interpreter, instance, arguments);
     }
     return instance;
 }
@@ -9,37 +9,60 @@
 
 class LoxInstance; 
 
-class LoxClass : public LoxCallable, public std::enable_shared_from_this<LoxClass> {
+/**
+ * A class and its methods. The method table is flattened when the class is
+ * created: the superclass's table is copied in and this class's own methods
+ * override entries in it, so a lookup is a single probe however deep the
+ * hierarchy. The initializer and its arity are cached alongside.
+ */
+class LoxClass : public LoxCallable, public Collectable<LoxClass> {
 public:
-    static std::shared_ptr<LoxClass> create(const std::string& name, std::weak_ptr<LoxClass> superclass, const std::unordered_map<std::string, std::shared_ptr<LoxFunction>>& methods) {
-        return std::shared_ptr<LoxClass>(new LoxClass(name, superclass, methods));
+    using MethodTable = std::unordered_map<SymbolId, Ref<LoxFunction>>;
+
+    static Ref<LoxClass> create(const std::string& name, const Ref<LoxClass>& superclass, const MethodTable& methods) {
+        return Ref<LoxClass>(new LoxClass(name, superclass, methods));
     }
     std::string toString() const override { return name; } // Only return class name
-    size_t arity() const override {
-        auto initializer = findMethod("init");
-        if (initializer == nullptr) return 0;
-        return initializer->arity();
-    }
+    size_t arity() const override { return initializerArity; }
     lox_literal call(Interpreter& interpreter, const std::vector<lox_literal>&) override;
     std::string getName() const { return name; }
-    std::shared_ptr<LoxFunction> findMethod(const std::string& name) const {
+    /** Identifies this class for as long as the process runs; ids are never reused. */
+    uint64_t getId() const { return id; }
+    /** The method, owned by this class, or nullptr. */
+    LoxFunction* findMethod(SymbolId name) const {
         auto it = methods.find(name);
         if (it != methods.end()) {
-            return it->second;
-        }
-        auto super = superclass.lock();
-        if (super) {
-            return super->findMethod(name);
+            return it->second.get();
         }
         return nullptr; // Method not found
     }
+    void trace(GcTracer& tracer) const override {
+        for (const auto& method : methods) tracer.visit(method.second.get());
+        tracer.visit(initializer.get());
+    }
+    void clearReferences() override {
+        methods.clear();
+        initializer.reset();
+    }
     ~LoxClass() override {
     }
 private:
-    LoxClass(const std::string& name, std::weak_ptr<LoxClass> superclass, const std::unordered_map<std::string, std::shared_ptr<LoxFunction>>& methods)
-        : name(name), superclass(superclass), methods(methods) {
+    LoxClass(const std::string& name, const Ref<LoxClass>& superclass, const MethodTable& ownMethods)
+        : name(name) {
+        if (superclass) {
+            methods = superclass->methods;
+        }
+        for (const auto& method : ownMethods) {
+            methods[method.first] = method.second;
+        }
+        initializer = Ref<LoxFunction>(findMethod(symbols::INIT));
+        initializerArity = initializer ? initializer->arity() : 0;
     }
+    static inline uint64_t nextId = 0;
+
     std::string name;
-    std::weak_ptr<LoxClass> superclass; // Now weak_ptr to break cycles
-    std::unordered_map<std::string, std::shared_ptr<LoxFunction>> methods;
+    uint64_t id = ++nextId;
+    MethodTable methods; // Own and inherited methods
+    Ref<LoxFunction> initializer;
+    size_t initializerArity = 0;
 };
\ No newline at end of file
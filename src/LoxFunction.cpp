@@ -3,55 +3,104 @@
 #include <iostream>
 
 lox_literal LoxFunction::call(Interpreter& interpreter, const std::vector<lox_literal>& arguments) {
-    // Create execution environment with closure as parent
-    auto environment = std::make_shared<Environment>(closure);
+    return callMethod(interpreter, boundInstance, arguments);
+}
 
-    // For bound methods, inject 'this' into the execution environment
-    if (boundInstance) {
-        environment->define("this", boundInstance);
-    }
+lox_literal LoxFunction::callMethod(Interpreter& interpreter, const Ref<LoxInstance>& receiver, const std::vector<lox_literal>& arguments) {
+    lox_literal result = run(interpreter, receiver, arguments);
 
-    // Add function parameters to the execution environment
-    for (size_t i = 0; i < declaration->params.size(); ++i) {
-        environment->define(declaration->params[i].getLexeme(), arguments[i]);
+    // A tail call runs after the frame of the call that made it is released, so it reuses that frame
+    Interpreter::TailCall tail;
+    Ref<LoxInstance> rebindTo;
+    while (interpreter.takeTailCall(tail)) {
+        if (!rebindTo) rebindTo = tail.receiver;
+        result = tail.function->run(interpreter, tail.receiver, tail.arguments);
     }
 
-    try {
-        // Execute the function body in the new environment
-        if (auto block = std::dynamic_pointer_cast<Block>(declaration->body)) {
-            interpreter.executeBlock(block->statements, environment);
-        } else {
-            std::vector<std::shared_ptr<Stmt>> bodyVec = {declaration->body};
-            interpreter.executeBlock(bodyVec, environment);
+    // As if each call had returned through Interpreter::callMethod: a returned function is bound to the outermost receiver
+    if (rebindTo && result.isCallable()) {
+        if (auto returned = dynamic_cast<LoxFunction*>(result.asCallable())) {
+            return returned->bind(rebindTo);
         }
-    } catch (const ReturnException& returnValue) {
-        // Initializers always return 'this', even if they explicitly return something else
-        if (isInitializer) {
-            return environment->getAt(0, "this");
+    }
+    return result;
+}
+
+lox_literal LoxFunction::run(Interpreter& interpreter, const Ref<LoxInstance>& receiver, const std::vector<lox_literal>& arguments) {
+    // Hot plain functions may run as native code instead
+    if (!receiver && !isInitializer && interpreter.getJit()) {
+        lox_literal result;
+        if (interpreter.getJit()->tryCall(interpreter, *this, arguments, result)) {
+            return result;
         }
-        return returnValue.getValue();
     }
-    
-    // Implicit return for initializers
-    if(isInitializer) {
-        return environment->getAt(0, "this");
+
+    // Create execution environment with closure as parent, reusing a spare frame when no closure captures it
+    bool captured = declaration->captured;
+    auto environment = captured ? makeRef<Environment>(closure, declaration->slotCount)
+                                : interpreter.acquireFrame(closure, declaration->slotCount);
+
+    // Methods keep the bound instance in slot 0, with the parameters after it
+    int slot = 0;
+    if (declaration->bindsThis) {
+        if (receiver) environment->setSlot(0, receiver);
+        slot = 1;
+    }
+
+    for (size_t i = 0; i < declaration->params.size(); ++i) {
+        environment->setSlot(slot++, arguments[i]);
+    }
+
+    // Execute the function body in the new environment
+    Completion completion;
+    if (compiledBody) {
+        completion = interpreter.executeCompiled(compiledBody->statements, environment);
+    } else if (auto block = std::dynamic_pointer_cast<Block>(declaration->body)) {
+        completion = interpreter.executeBlock(block->statements, environment);
+    } else {
+        std::vector<std::shared_ptr<Stmt>> bodyVec = {declaration->body};
+        completion = interpreter.executeBlock(bodyVec, environment);
+    }
+    lox_literal result = completion == Completion::RETURN ? interpreter.takeReturnValue() : lox_literal();
+
+    // Initializers always return 'this', even if they explicitly return something else
+    if (isInitializer) {
+        result = environment->getSlot(0);
+    }
+    if (!captured) {
+        interpreter.releaseFrame(std::move(environment));
     }
-    return lox_literal(std::monostate{});
+    return result;
 }
 
-std::shared_ptr<LoxFunction> LoxFunction::bind(const std::shared_ptr<LoxInstance>& instance) const {
+Ref<LoxFunction> LoxFunction::bind(const Ref<LoxInstance>& instance) const {
     // Get the original unbound function to avoid chains of bound functions
     auto orig = getUnbound();
     
     // Create a new bound function that will inject 'this' during execution
-    auto boundFunction = std::make_shared<LoxFunction>(orig->declaration, orig->closure, orig->isInitializer, orig);
+    auto boundFunction = makeRef<LoxFunction>(orig->declaration, orig->closure, orig->isInitializer, orig);
     boundFunction->boundInstance = instance;
+    boundFunction->compiledBody = orig->compiledBody;
     return boundFunction;
 }
 
-std::shared_ptr<LoxFunction> LoxFunction::getUnbound() const {
+Ref<LoxFunction> LoxFunction::getUnbound() const {
     if (original) {
         return original->getUnbound();
     }
-    return std::const_pointer_cast<LoxFunction>(shared_from_this());
+    return Ref<LoxFunction>(const_cast<LoxFunction*>(this));
+}
+
+LoxFunction::~LoxFunction() {}
+
+void LoxFunction::trace(GcTracer& tracer) const {
+    tracer.visit(closure.get());
+    tracer.visit(original.get());
+    tracer.visit(boundInstance.get());
+}
+
+void LoxFunction::clearReferences() {
+    closure.reset();
+    original.reset();
+    boundInstance.reset();
 }
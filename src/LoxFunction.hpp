@@ -2,9 +2,10 @@
 #include "token.hpp"
 #include "LoxCallable.hpp"
 #include "Environment.hpp"
-#include "ReturnException.hpp"
 #include "literal.hpp"
 #include "Stmt.hpp"
+#include "CompiledCode.hpp"
+#include "Gc.hpp"
 #include <memory>
 
 class Interpreter;
@@ -14,28 +15,32 @@ class LoxInstance;
  * Represents a Lox function or method. Handles closures, method binding,
  * and proper 'this' and 'super' resolution for inheritance.
  */
-class LoxFunction : public LoxCallable, public std::enable_shared_from_this<LoxFunction> {
+class LoxFunction : public LoxCallable, public Collectable<LoxFunction>, public HeapObject<HeapKind::FUNCTION> {
     std::shared_ptr<Function> declaration;      // The function's AST node
-    std::shared_ptr<Environment> closure;       // Captured environment (lexical scope)
+    Ref<Environment> closure;                   // Captured environment (lexical scope)
     bool isInitializer = false;                 // True if this is a class initializer
-    std::shared_ptr<LoxFunction> original;      // Original unbound function (for bound methods)
-    std::shared_ptr<LoxInstance> boundInstance; // Instance this method is bound to
+    Ref<LoxFunction> original;                  // Original unbound function (for bound methods)
+    Ref<LoxInstance> boundInstance;             // Instance this method is bound to
+    std::shared_ptr<CompiledBody> compiledBody; // Body from the ClosureCompiler, if any
 
 public:
     /** Create an unbound function. */
-    LoxFunction(std::shared_ptr<Function> declaration, std::shared_ptr<Environment> closure, bool isInitializer)
+    LoxFunction(std::shared_ptr<Function> declaration, Ref<Environment> closure, bool isInitializer)
         : declaration(std::move(declaration)), closure(std::move(closure)), isInitializer(isInitializer), original(nullptr), boundInstance(nullptr) {}
     
     /** Create a bound function (used internally by bind()). */
-    LoxFunction(std::shared_ptr<Function> declaration, std::shared_ptr<Environment> closure, bool isInitializer, std::shared_ptr<LoxFunction> original)
+    LoxFunction(std::shared_ptr<Function> declaration, Ref<Environment> closure, bool isInitializer, Ref<LoxFunction> original)
         : declaration(std::move(declaration)), closure(std::move(closure)), isInitializer(isInitializer), original(std::move(original)), boundInstance(nullptr) {}
 
     /** Execute the function with given arguments. */
     lox_literal call(Interpreter& interpreter, const std::vector<lox_literal>& arguments) override;
 
+    /** Execute a method with `receiver` as 'this', without binding a copy of it first. */
+    lox_literal callMethod(Interpreter& interpreter, const Ref<LoxInstance>& receiver, const std::vector<lox_literal>& arguments);
+
     /** String representation of the function. */
     std::string toString() const override {
-        return "<fn " + declaration->name.getLexeme() + ">";
+        return "<fn " + std::string(declaration->name.getLexeme()) + ">";
     }
 
     /** Number of parameters this function expects. */
@@ -44,16 +49,29 @@ public:
     }
 
     /** Create a new function bound to a specific instance (for methods). */
-    std::shared_ptr<LoxFunction> bind(const std::shared_ptr<LoxInstance>& instance) const;
+    Ref<LoxFunction> bind(const Ref<LoxInstance>& instance) const;
 
     /** Get the original unbound function. */
-    std::shared_ptr<LoxFunction> getUnbound() const;
+    Ref<LoxFunction> getUnbound() const;
+
+    /** Get the function's AST node. */
+    const Function& getDeclaration() const { return *declaration; }
+
+    /** Run this pre-compiled body instead of walking the declaration's AST. */
+    void setCompiledBody(std::shared_ptr<CompiledBody> body) { compiledBody = std::move(body); }
 
     /** Get the captured closure environment. */
-    std::shared_ptr<Environment> getClosure() const { return closure; }
+    Ref<Environment> getClosure() const { return closure; }
 
     /** Get the instance this function is bound to (if any). */
-    std::shared_ptr<LoxInstance> getBoundInstance() const { return boundInstance; }
+    Ref<LoxInstance> getBoundInstance() const { return boundInstance; }
+
+    void trace(GcTracer& tracer) const override;
+    void clearReferences() override;
+
+    ~LoxFunction() override;
 
-    ~LoxFunction() override {}
+private:
+    /** One call of the body, leaving any tail call it makes pending in the interpreter. */
+    lox_literal run(Interpreter& interpreter, const Ref<LoxInstance>& receiver, const std::vector<lox_literal>& arguments);
 };
\ No newline at end of file
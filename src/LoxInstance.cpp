@@ -6,10 +6,28 @@
 // Use 'class' consistently for all AST node types to avoid C4099 warnings
 // Example: class Assign; class Binary; ...
 
-LoxInstance::LoxInstance(std::shared_ptr<LoxClass> klass) : klass(std::move(klass)) {}
+Ref<LoxInstance> LoxInstance::create(Ref<LoxClass> klass) {
+    return makeRef<LoxInstance>(Private{}, std::move(klass));
+}
+
+LoxInstance::LoxInstance(Private, Ref<LoxClass> klass) : klass(std::move(klass)) {}
 
 LoxInstance::~LoxInstance() {}
 
+void LoxInstance::trace(GcTracer& tracer) const {
+    tracer.visit(klass.get());
+    for (const auto& value : fields) tracer.visit(value);
+    if (dictionary) {
+        for (const auto& field : *dictionary) tracer.visit(field.second);
+    }
+}
+
+void LoxInstance::clearReferences() {
+    klass.reset();
+    fields.clear();
+    dictionary.reset();
+}
+
 std::string LoxInstance::toString() const {
     return klass->getName() + " instance";
 }
@@ -24,21 +42,16 @@ lox_literal LoxInstance::get(const Token& name) {
         throw RuntimeError(name, "Internal error: instance has no class.");
     }
     try {
-        auto it = fields.find(name.getLexeme());
-        if (it != fields.end()) {
+        if (lox_literal* field = findField(name.getSymbol())) {
             // Per Crafting Interpreters: if the property is in fields, return as-is (do NOT rebind)
-            return it->second;
+            return *field;
         }
-        std::shared_ptr<LoxFunction> method = klass->findMethod(name.getLexeme());
+        LoxFunction* method = klass->findMethod(name.getSymbol());
         if (method) {
             // Per Crafting Interpreters: if found on class, bind to this instance
-            try {
-                return method->bind(shared_from_this());
-            } catch (const std::bad_weak_ptr&) {
-                throw RuntimeError(name, "Internal error: invalid instance reference.");
-            }
+            return method->bind(Ref<LoxInstance>(this));
         }
-        throw RuntimeError(name, "Undefined property '" + name.getLexeme() + "'.");
+        throw RuntimeError(name, "Undefined property '" + std::string(name.getLexeme()) + "'.");
     } catch (const RuntimeError&) {
         throw; // Already a RuntimeError, propagate
     } catch (const std::exception& e) {
@@ -50,5 +63,92 @@ lox_literal LoxInstance::get(const Token& name) {
 
 void LoxInstance::set(const Token& name, const lox_literal& value) {
     // Per Crafting Interpreters: do NOT rebind methods on assignment, just store as-is
-    fields[name.getLexeme()] = value;
+    SymbolId symbol = name.getSymbol();
+    if (lox_literal* field = findField(symbol)) {
+        *field = value;
+        return;
+    }
+    if (shape && shape->fieldCount() < Shape::MAX_FIELDS) {
+        shape = shape->withField(symbol);
+        fields.push_back(value);
+        return;
+    }
+    if (shape) toDictionary();
+    (*dictionary)[symbol] = value;
+}
+
+lox_literal LoxInstance::get(const Token& name, GetCache& cache) {
+    lox_literal field;
+    if (LoxFunction* method = findProperty(name, cache, field)) {
+        return method->bind(Ref<LoxInstance>(this));
+    }
+    return field;
+}
+
+LoxFunction* LoxInstance::findProperty(const Token& name, GetCache& cache, lox_literal& field) {
+    if (shape) {
+        uint64_t classId = klass->getId();
+        const GetCacheEntry* hit = cache.find([&](const GetCacheEntry& entry) {
+            return entry.shape == shape && entry.classId == classId;
+        });
+        if (hit) {
+            if (hit->slot >= 0) field = fields[hit->slot];
+            return hit->method;
+        }
+    }
+
+    SymbolId symbol = name.getSymbol();
+    if (lox_literal* value = findField(symbol)) {
+        if (shape) cache.add(GetCacheEntry{shape, klass->getId(), shape->find(symbol), nullptr});
+        field = *value;
+        return nullptr;
+    }
+    LoxFunction* method = klass->findMethod(symbol);
+    if (!method) {
+        throw RuntimeError(name, "Undefined property '" + std::string(name.getLexeme()) + "'.");
+    }
+    if (shape) cache.add(GetCacheEntry{shape, klass->getId(), -1, method});
+    return method;
+}
+
+void LoxInstance::set(const Token& name, const lox_literal& value, SetCache& cache) {
+    if (!shape) {
+        set(name, value);
+        return;
+    }
+    const SetCacheEntry* hit = cache.find([&](const SetCacheEntry& entry) { return entry.shape == shape; });
+    if (hit) {
+        if (hit->next == shape) {
+            fields[hit->slot] = value;
+        } else {
+            shape = hit->next;
+            fields.push_back(value);
+        }
+        return;
+    }
+    Shape* before = shape;
+    set(name, value);
+    if (shape) {
+        cache.add(SetCacheEntry{before, shape, shape->find(name.getSymbol())});
+    }
+}
+
+lox_literal* LoxInstance::findField(SymbolId name) {
+    if (shape) {
+        int slot = shape->find(name);
+        return slot >= 0 ? &fields[slot] : nullptr;
+    }
+    auto it = dictionary->find(name);
+    return it != dictionary->end() ? &it->second : nullptr;
+}
+
+void LoxInstance::toDictionary() {
+    dictionary = std::make_unique<std::unordered_map<SymbolId, lox_literal>>();
+    const std::vector<SymbolId>& names = shape->fieldNames();
+    for (size_t i = 0; i < names.size(); ++i) {
+        dictionary->emplace(names[i], std::move(fields[i]));
+    }
+    fields.clear();
+    fields.shrink_to_fit();
+    shape = nullptr;
 }
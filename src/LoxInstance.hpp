@@ -4,23 +4,53 @@
 #include "Environment.hpp"
 #include "LoxCallable.hpp"
 #include "LoxFunction.hpp"
+#include "Shape.hpp"
+#include "InlineCache.hpp"
 #include <unordered_map>
 
 class LoxClass; // Forward declaration
 
-class LoxInstance : public LoxCallable, public std::enable_shared_from_this<LoxInstance> {
+class LoxInstance : public LoxCallable, public Collectable<LoxInstance>, public HeapObject<HeapKind::INSTANCE> {
 public:
-    static std::shared_ptr<LoxInstance> create(std::shared_ptr<LoxClass> klass) {
-        return std::shared_ptr<LoxInstance>(new LoxInstance(std::move(klass)));
-    }
+    static Ref<LoxInstance> create(Ref<LoxClass> klass);
+
+private:
+    /** Only create() can name this, so instances are always owned by a Ref. */
+    struct Private {
+        explicit Private() = default;
+    };
+
+public:
+    LoxInstance(Private, Ref<LoxClass> klass);
     std::string toString() const override;
     size_t arity() const override { return 0; }
     lox_literal call(Interpreter& interpreter, const std::vector<lox_literal>&) override;
     lox_literal get(const Token& name);
     void set(const Token& name, const lox_literal& value);
+    /** get() and set() through a site's inline cache. */
+    lox_literal get(const Token& name, GetCache& cache);
+    /**
+     * get() without binding: returns the class's method, or nullptr after
+     * storing the field's value in `field`. The method stays alive as long
+     * as this instance's class does.
+     */
+    LoxFunction* findProperty(const Token& name, GetCache& cache, lox_literal& field);
+    void set(const Token& name, const lox_literal& value, SetCache& cache);
+    void trace(GcTracer& tracer) const override;
+    void clearReferences() override;
     ~LoxInstance() override;
 private:
-    LoxInstance(std::shared_ptr<LoxClass> klass);
-    std::shared_ptr<LoxClass> klass;
-    std::unordered_map<std::string, lox_literal> fields;
-};
\ No newline at end of file
+    /** The field's value, or nullptr if this instance has no such field. */
+    lox_literal* findField(SymbolId name);
+    /** Move the fields into a dictionary, for instances with more than Shape::MAX_FIELDS. */
+    void toDictionary();
+
+    Ref<LoxClass> klass;
+    Shape* shape = Shape::empty(); // Layout of fields, or nullptr in dictionary mode
+    std::vector<lox_literal, HeapAllocator<lox_literal, HeapKind::INSTANCE>> fields; // Indexed by the shape's slots
+    std::unique_ptr<std::unordered_map<SymbolId, lox_literal>> dictionary;
+};
+
+inline LoxInstance* Value::asInstance() const {
+    return static_cast<LoxInstance*>(asObject());
+}
@@ -0,0 +1,160 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <vector>
+
+/**
+ * Immutable Lox string. The characters are stored inline, right after the
+ * header in the same allocation, so a string costs one malloc however short
+ * it is and never has a separate buffer. Values share a LoxString through a
+ * plain reference count, which makes copying a string O(1). The hash is
+ * computed the first time it is needed and cached, so equality checks on
+ * strings that differ usually stop without looking at the characters.
+ *
+ * Concatenating longer strings builds a rope node that just points at both
+ * halves, so `s = s + piece` in a loop costs O(1) per step instead of a copy
+ * of everything so far. A rope is flattened into one buffer only when its
+ * characters are needed (printing, comparing, hashing), and concatenation
+ * flattens instead once a rope gets MAX_ROPE_DEPTH levels deep, which keeps
+ * ropes shallow and releasing them cheap.
+ */
+class LoxString {
+public:
+    static LoxString* create(std::string_view text) {
+        LoxString* string = allocate(text.size());
+        std::memcpy(string->data(), text.data(), text.size());
+        return string;
+    }
+
+    /** left + right: short results are copied, longer ones share both halves in a rope node. */
+    static LoxString* concat(const LoxString& left, const LoxString& right) {
+        size_t length = left.length + right.length;
+        int depth = std::max(left.ropeDepth(), right.ropeDepth()) + 1;
+        if (length <= SMALL_CONCAT_BYTES || depth > MAX_ROPE_DEPTH) {
+            LoxString* string = allocate(length);
+            left.copyTo(string->data());
+            right.copyTo(string->data() + left.length);
+            return string;
+        }
+        void* memory = ::operator new(sizeof(LoxString) + sizeof(Rope));
+        LoxString* string = new (memory) LoxString(length);
+        string->depth = static_cast<uint16_t>(depth);
+        left.retain();
+        right.retain();
+        new (string + 1) Rope{&left, &right, nullptr};
+        return string;
+    }
+
+    LoxString(const LoxString&) = delete;
+    LoxString& operator=(const LoxString&) = delete;
+
+    std::string_view view() const { return {flat()->data(), length}; }
+    size_t size() const { return length; }
+
+    /** FNV-1a over the characters; never 0, which marks a hash not computed yet. */
+    uint64_t hash() const {
+        if (hashCode == 0) {
+            std::string_view text = view();
+            uint64_t h = 14695981039346656037ull;
+            for (unsigned char c : text) {
+                h = (h ^ c) * 1099511628211ull;
+            }
+            hashCode = h == 0 ? 1 : h;
+        }
+        return hashCode;
+    }
+
+    bool equals(const LoxString& other) const {
+        if (this == &other) return true;
+        if (length != other.length || hash() != other.hash()) return false;
+        return view() == other.view();
+    }
+
+    void retain() const { ++refCount; }
+
+    void release() const {
+        if (--refCount > 0) return;
+        if (depth > 0) {
+            const Rope& parts = rope();
+            if (parts.left) parts.left->release();
+            if (parts.right) parts.right->release();
+            if (parts.flat) parts.flat->release();
+        }
+        LoxString* self = const_cast<LoxString*>(this);
+        self->~LoxString();
+        ::operator delete(self);
+    }
+
+private:
+    /** The two halves of a rope node, replaced by one flat copy once its characters are needed. */
+    struct Rope {
+        const LoxString* left;
+        const LoxString* right;
+        const LoxString* flat;
+    };
+
+    static constexpr size_t LARGE_STRING_BYTES = 4096;
+    static constexpr size_t SMALL_CONCAT_BYTES = 64;
+    static constexpr int MAX_ROPE_DEPTH = 1024;
+
+    explicit LoxString(size_t length) : length(length) {}
+    ~LoxString() = default;
+
+    static LoxString* allocate(size_t length) {
+        size_t bytes = sizeof(LoxString) + length;
+        // Round big strings up to a power of two so the blocks freed as a string grows
+        // by concatenation can be reused, the way std::string's capacity doubling allows
+        if (bytes > LARGE_STRING_BYTES) bytes = std::bit_ceil(bytes);
+        void* memory = ::operator new(bytes);
+        return new (memory) LoxString(length);
+    }
+
+    Rope& rope() const { return *reinterpret_cast<Rope*>(const_cast<LoxString*>(this) + 1); }
+
+    /** Levels of unflattened rope below this string; 0 once its characters are in one buffer. */
+    int ropeDepth() const { return depth > 0 && !rope().flat ? depth : 0; }
+
+    /** This string's characters in one buffer, flattening a rope the first time. */
+    const LoxString* flat() const {
+        if (depth == 0) return this;
+        Rope& parts = rope();
+        if (!parts.flat) {
+            LoxString* string = allocate(length);
+            copyTo(string->data());
+            parts.left->release();
+            parts.right->release();
+            parts.left = parts.right = nullptr;
+            parts.flat = string;
+        }
+        return parts.flat;
+    }
+
+    /** Copy the characters out without flattening, walking rope nodes iteratively. */
+    void copyTo(char* out) const {
+        std::vector<const LoxString*> pending{this};
+        while (!pending.empty()) {
+            const LoxString* string = pending.back();
+            pending.pop_back();
+            if (string->depth == 0 || string->rope().flat) {
+                const LoxString* leaf = string->depth == 0 ? string : string->rope().flat;
+                std::memcpy(out, leaf->data(), leaf->length);
+                out += leaf->length;
+            } else {
+                pending.push_back(string->rope().right);
+                pending.push_back(string->rope().left);
+            }
+        }
+    }
+
+    char* data() { return reinterpret_cast<char*>(this + 1); }
+    const char* data() const { return reinterpret_cast<const char*>(this + 1); }
+
+    mutable uint32_t refCount = 1;
+    uint16_t depth = 0; // 0 for a flat string, else the height of this rope node
+    size_t length;
+    mutable uint64_t hashCode = 0;
+};
@@ -0,0 +1,100 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Base of the runtime objects shared through Ref: environments and
+ * callables (functions, classes, instances). The reference count lives in
+ * the object itself and is a plain integer, since the interpreter is
+ * single-threaded, so sharing an object costs no atomic instruction and no
+ * separate control block. A Value holding a callable or instance counts as
+ * one reference, the same as a Ref.
+ */
+class RefCounted {
+public:
+    RefCounted() = default;
+    RefCounted(const RefCounted&) = delete;
+    RefCounted& operator=(const RefCounted&) = delete;
+
+    void retain() const { ++refCount; }
+
+    /** Drop a reference; the last one deletes the object. */
+    void release() const {
+        if (--refCount == 0) delete this;
+    }
+
+    /** How many references there are; 0 while the object is still being constructed. */
+    uint32_t references() const { return refCount; }
+
+protected:
+    virtual ~RefCounted() = default;
+
+private:
+    mutable uint32_t refCount = 0;
+};
+
+/**
+ * Owning handle to a RefCounted object, the intrusive counterpart of
+ * std::shared_ptr. Since the count is in the object, a Ref can be made
+ * from any raw pointer to a live object, such as `this`.
+ */
+template <typename T>
+class Ref {
+public:
+    Ref() = default;
+    Ref(std::nullptr_t) {}
+
+    explicit Ref(T* object) : object(object) {
+        if (object) object->retain();
+    }
+
+    Ref(const Ref& other) : Ref(other.object) {}
+    Ref(Ref&& other) noexcept : object(std::exchange(other.object, nullptr)) {}
+
+    template <typename U, std::enable_if_t<std::is_convertible_v<U*, T*>, int> = 0>
+    Ref(const Ref<U>& other) : Ref(other.get()) {}
+
+    template <typename U, std::enable_if_t<std::is_convertible_v<U*, T*>, int> = 0>
+    Ref(Ref<U>&& other) noexcept : object(other.detach()) {}
+
+    ~Ref() {
+        if (object) object->release();
+    }
+
+    Ref& operator=(Ref other) noexcept {
+        std::swap(object, other.object);
+        return *this;
+    }
+
+    T* get() const { return object; }
+    T& operator*() const { return *object; }
+    T* operator->() const { return object; }
+    explicit operator bool() const { return object != nullptr; }
+
+    void reset() { Ref().swap(*this); }
+    void swap(Ref& other) noexcept { std::swap(object, other.object); }
+
+    /** Give up ownership without releasing; the caller takes over the reference. */
+    T* detach() { return std::exchange(object, nullptr); }
+
+    template <typename U>
+    bool operator==(const Ref<U>& other) const { return object == other.get(); }
+    bool operator==(std::nullptr_t) const { return object == nullptr; }
+
+private:
+    T* object = nullptr;
+};
+
+/** Construct a T and return the first reference to it. */
+template <typename T, typename... Args>
+Ref<T> makeRef(Args&&... args) {
+    return Ref<T>(new T(std::forward<Args>(args)...));
+}
+
+/** The object as a T, or null if it is not one. */
+template <typename T, typename U>
+Ref<T> dynamicRefCast(const Ref<U>& ref) {
+    return Ref<T>(dynamic_cast<T*>(ref.get()));
+}
@@ -29,12 +29,13 @@ enum class ClassType {
 
 /**
  * The Resolver performs static analysis on the AST to resolve variable 
- * bindings and detect scope-related errors. It calculates the distance
- * from each variable use to its declaration for efficient lookup.
+ * bindings and detect scope-related errors. It writes the distance and
+ * slot of each local variable use into the node itself, so the engines
+ * read them straight from the AST.
  */
 class Resolver : public ExprVisitorEval, public StmtVisitorEval {
 public:
-    Resolver(Interpreter& interpreter) : interpreter(interpreter) {}
+    Resolver() = default;
     
     /** Start a new lexical scope. */
     void beginScope() {
@@ -46,23 +47,24 @@ public:
         beginScope();
         auto& stmts = const_cast<std::vector<std::shared_ptr<Stmt>>&>(stmt.statements);
         resolve(stmts);
-        endScope();
+        stmt.captured = scopes.back().captured;
+        stmt.slotCount = endScope();
         return std::monostate{};
     }
 
     /** Resolve variable access, checking for self-initialization. */
     lox_literal visit(const Variable& expr) override {
-        if (!scopes.empty() && scopes.back().count(expr.name.getLexeme()) && scopes.back().at(expr.name.getLexeme()) == false) {
-            throw RuntimeError(expr.name, "Cannot read variable '" + expr.name.getLexeme() + "' in its own initializer.");
+        if (!scopes.empty() && scopes.back().variables.count(expr.name.getLexeme()) && !scopes.back().variables.at(expr.name.getLexeme()).defined) {
+            throw RuntimeError(expr.name, "Cannot read variable '" + std::string(expr.name.getLexeme()) + "' in its own initializer.");
         }
-        resolveLocal(expr, expr.name);
+        resolveLocal(expr.local, expr.name);
         return std::monostate{};
     }
 
     /** Resolve variable assignment. */
     lox_literal visit(const Assign& expr) override {
         resolve(*expr.value);
-        resolveLocal(expr, expr.name);
+        resolveLocal(expr.local, expr.name);
         return std::monostate{};
     }
 
@@ -116,7 +118,7 @@ public:
         if (currentClass == ClassType::NONE) {
             throw RuntimeError(expr.keyword, "Can't use 'this' outside of a class.");
         }
-        resolveLocal(expr, expr.keyword);
+        resolveLocal(expr.local, expr.keyword);
         return std::monostate{};
     }
 
@@ -127,12 +129,12 @@ public:
         } else if (currentClass != ClassType::SUBCLASS) {
             throw RuntimeError(expr.keyword, "Can't use 'super' in a class with no superclass.");
         }
-        resolveLocal(expr, expr.keyword);
+        resolveLocal(expr.local, expr.keyword);
         return std::monostate{};
     }
 
     lox_literal visit(const Var& stmt) override {
-        declare(stmt.name);
+        stmt.slot = declare(stmt.name);
         if (stmt.initializer != nullptr) {
             resolve(*stmt.initializer);
         }
@@ -141,7 +143,8 @@ public:
     }
 
     lox_literal visit(const Function& stmt) override {
-        declare(stmt.name);
+        captureScopes();
+        stmt.slot = declare(stmt.name);
         define(stmt.name);
         resolveFunction(stmt, FunctionType::FUNCTION);
         return std::monostate{};
@@ -175,6 +178,7 @@ public:
                 throw RuntimeError(stmt.keyword, "Can't return a value from an initializer.");
             }
             resolve(*stmt.value);
+            stmt.tailCall = dynamic_cast<const Call*>(stmt.value.get()) != nullptr;
         }
         return std::monostate{};
     }
@@ -188,8 +192,9 @@ public:
     lox_literal visit(const Class& stmt) override {
         ClassType enclosingClass = currentClass;
         currentClass = ClassType::CLASS;
+        captureScopes(); // The methods close over the current scope
         
-        declare(stmt.name);
+        stmt.slot = declare(stmt.name);
         define(stmt.name);
         
         if (stmt.superclass.has_value()) {
@@ -204,11 +209,11 @@ public:
             }
             
             beginScope();
-            scopes.back()["super"] = true;
+            declareImplicit("super");
         }
         
         beginScope();
-        scopes.back()["this"] = true;
+        declareImplicit("this");
         
         for( const auto& method : stmt.methods) {
             FunctionType declaration = FunctionType::METHOD;
@@ -243,8 +248,19 @@ public:
     }
 
 private:
-    Interpreter& interpreter;
-    std::vector<std::unordered_map<std::string, bool>> scopes;
+    /** A variable declared in a local scope. */
+    struct Local {
+        bool defined; // False until its initializer has been resolved
+        int slot;     // Index in its scope's Environment, in declaration order
+    };
+
+    /** A local scope being resolved. */
+    struct Scope {
+        std::unordered_map<std::string_view, Local> variables; // Keys view the source or string literals
+        bool captured = false; // Some closure declared inside refers to this scope's Environment
+    };
+
+    std::vector<Scope> scopes;
     FunctionType currentFunction = FunctionType::NONE;
     ClassType currentClass = ClassType::NONE;
 
@@ -253,9 +269,10 @@ private:
         currentFunction = type;
         beginScope(); // Create scope for this function
         
-        // Add 'this' for methods
+        // Add 'this' for methods, in slot 0 where LoxFunction::call puts the bound instance
         if (type == FunctionType::METHOD || type == FunctionType::INITIALIZER) {
-            scopes.back()["this"] = true;
+            declareImplicit("this");
+            function.bindsThis = true;
         }
         
         // Add parameters to this function's scope
@@ -273,39 +290,64 @@ private:
             resolve(*function.body);
         }
         
-        endScope(); // Pop this function's scope
+        function.captured = scopes.back().captured;
+        function.slotCount = endScope(); // Pop this function's scope
         currentFunction = enclosingFunction;
     }
 
-    void declare(const Token& name) {
+    /** Declare a variable in the innermost scope. Returns its slot, or -1 for a global. */
+    int declare(const Token& name) {
         // Only check for redeclaration in local scopes, not global
-        if (scopes.empty()) return;
-        auto& scope = scopes.back();
+        if (scopes.empty()) return -1;
+        auto& scope = scopes.back().variables;
         if (scope.find(name.getLexeme()) != scope.end()) {
-            throw RuntimeError(name, "Variable '" + name.getLexeme() + "' already declared in this scope.");
+            throw RuntimeError(name, "Variable '" + std::string(name.getLexeme()) + "' already declared in this scope.");
         }
-        scope[name.getLexeme()] = false;
+        int slot = static_cast<int>(scope.size());
+        scope[name.getLexeme()] = Local{false, slot};
+        return slot;
     }
 
     void define(const Token& name) {
         if (scopes.empty()) return;
-        scopes.back()[name.getLexeme()] = true;
+        scopes.back().variables[name.getLexeme()].defined = true;
+    }
+
+    /** Declare and define 'this' or 'super', which the runtime binds itself. */
+    void declareImplicit(std::string_view name) {
+        auto& scope = scopes.back().variables;
+        int slot = static_cast<int>(scope.size());
+        scope[name] = Local{true, slot};
+    }
+
+    /**
+     * A function or class declared here keeps the current Environment, and
+     * with it every enclosing one, alive after its scope exits, so none of
+     * them may be recycled.
+     */
+    void captureScopes() {
+        for (auto& scope : scopes) {
+            scope.captured = true;
+        }
     }
 
-    void endScope() {
+    /** Pop the innermost scope. Returns how many slots its Environment needs. */
+    int endScope() {
         if (scopes.empty()) {
             throw RuntimeError(Token(TokenType::IDENTIFIER, "", std::monostate{}, 0), "No scope to end.");
         }
+        int slotCount = static_cast<int>(scopes.back().variables.size());
         scopes.pop_back();
+        return slotCount;
     }
 
-    void resolveLocal(const Expr& expr, const Token& name) {
+    /** Record in the node where a variable lives; a name in no local scope is left global. */
+    void resolveLocal(LocalSlot& local, const Token& name) {
         for (int i = static_cast<int>(scopes.size()) - 1; i >= 0; --i) {
-            auto it = scopes[i].find(name.getLexeme());
-            if (it != scopes[i].end()) {
+            auto it = scopes[i].variables.find(name.getLexeme());
+            if (it != scopes[i].variables.end()) {
                 int distance = static_cast<int>(scopes.size() - 1 - i);
-                // Always record distance for variables found in local scopes
-                interpreter.resolve(&expr, distance);
+                local = LocalSlot{distance, it->second.slot};
                 return;
             }
         }
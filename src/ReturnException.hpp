@@ -1,19 +0,0 @@
-#pragma once
-#include <exception>
-#include "token.hpp"
-#include "literal.hpp"
-
-class ReturnException : public std::exception {
-public:
-    explicit ReturnException(const lox_literal& value) : value(value) {    
-    }
-
-    const char* what() const noexcept override {
-        return "ReturnException";
-    }
-
-    lox_literal getValue() const {
-        return value;
-    }
-    lox_literal value;
-};
\ No newline at end of file
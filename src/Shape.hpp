@@ -0,0 +1,61 @@
+#pragma once
+#include <memory>
+#include <utility>
+#include <vector>
+#include "Symbol.hpp"
+
+/**
+ * The field layout shared by instances that were given the same fields in
+ * the same order: field i of such an instance lives in slot i. Shapes form
+ * a process-wide tree rooted at empty(); adding a field moves an instance
+ * to the child shape for that name, created on first use, so instances
+ * built the same way share one Shape and a field lookup is a short scan of
+ * its names instead of a hash table per instance.
+ */
+class Shape {
+public:
+    /** Instances with more fields than this leave the tree for a dictionary. */
+    static constexpr size_t MAX_FIELDS = 16;
+
+    /** The shape of an instance with no fields. */
+    static Shape* empty() {
+        static Shape root;
+        return &root;
+    }
+
+    /** Slot of the field, or -1 if this shape has no such field. */
+    int find(SymbolId name) const {
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (names[i] == name) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    /** The shape reached by adding a field this shape does not have; it gets the next slot. */
+    Shape* withField(SymbolId name) {
+        for (const auto& transition : transitions) {
+            if (transition.first == name) return transition.second.get();
+        }
+        auto child = std::unique_ptr<Shape>(new Shape(*this, name));
+        Shape* shape = child.get();
+        transitions.emplace_back(name, std::move(child));
+        return shape;
+    }
+
+    size_t fieldCount() const { return names.size(); }
+
+    /** Field names in slot order. */
+    const std::vector<SymbolId>& fieldNames() const { return names; }
+
+    Shape(const Shape&) = delete;
+    Shape& operator=(const Shape&) = delete;
+
+private:
+    Shape() = default;
+    Shape(const Shape& parent, SymbolId name) : names(parent.names) {
+        names.push_back(name);
+    }
+
+    std::vector<SymbolId> names;
+    std::vector<std::pair<SymbolId, std::unique_ptr<Shape>>> transitions;
+};
@@ -0,0 +1,37 @@
+#include "SourceFile.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceFile::SourceFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* memory = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (memory != MAP_FAILED) {
+            data = static_cast<const char*>(memory);
+            size = static_cast<size_t>(info.st_size);
+            mapped = open = true;
+            ::close(fd);
+            return;
+        }
+    }
+
+    char buffer[1 << 16];
+    ssize_t count;
+    while ((count = ::read(fd, buffer, sizeof buffer)) > 0) {
+        contents.append(buffer, static_cast<size_t>(count));
+    }
+    ::close(fd);
+    if (count < 0) return;
+    data = contents.data();
+    size = contents.size();
+    open = true;
+}
+
+SourceFile::~SourceFile() {
+    if (mapped) munmap(const_cast<char*>(data), size);
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ * A Lox source file mapped read-only into memory. Tokens view their lexemes
+ * in its text instead of copying them, so it must outlive every token and
+ * AST node made from it; main keeps it open for the whole program. Files
+ * that cannot be mapped, such as pipes, are read into memory instead.
+ */
+class SourceFile {
+public:
+    explicit SourceFile(const std::string& path);
+    ~SourceFile();
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    /** False if the file could not be opened or read. */
+    bool isOpen() const { return open; }
+
+    std::string_view text() const { return std::string_view(data, size); }
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    bool open = false;
+    std::string contents; // The text when it is not mapped
+};
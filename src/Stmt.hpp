@@ -61,6 +61,9 @@ public:
     void accept(const StmtVisitorPrint& visitor) const override { visitor.visit(*this); }
     lox_literal accept(StmtVisitorEval& visitor) const override { return visitor.visit(*this); }
     std::vector<std::shared_ptr<Stmt>> statements;
+    // Set by the Resolver
+    mutable int slotCount = 0;     // Variables declared directly in the block
+    mutable bool captured = false; // A function or class declared inside keeps the block's scope alive
 };
 
 class Class : public Stmt {
@@ -71,6 +74,7 @@ public:
     Token name;
     std::optional<std::shared_ptr<Expr>> superclass;
     std::vector<std::shared_ptr<Function>> methods;
+    mutable int slot = -1; // Slot of the class name in its scope, or -1 for a global; set by the Resolver
 };
 
 class Expression : public Stmt {
@@ -89,6 +93,11 @@ public:
     Token name;
     std::vector<Token> params;
     std::shared_ptr<Stmt> body;
+    // Set by the Resolver
+    mutable int slot = -1;          // Slot of the function name in its scope, or -1 for a global or method
+    mutable int slotCount = 0;      // Variables in the function's own scope: 'this', parameters, body locals
+    mutable bool bindsThis = false; // Methods keep 'this' in slot 0, ahead of the parameters
+    mutable bool captured = false;  // A function or class declared in the body keeps the call's scope alive
 };
 
 class If : public Stmt {
@@ -116,6 +125,7 @@ public:
     lox_literal accept(StmtVisitorEval& visitor) const override { return visitor.visit(*this); }
     Token keyword;
     std::shared_ptr<Expr> value;
+    mutable bool tailCall = false; // The value is a call whose result is returned as is; set by the Resolver
 };
 
 class Var : public Stmt {
@@ -125,6 +135,7 @@ public:
     lox_literal accept(StmtVisitorEval& visitor) const override { return visitor.visit(*this); }
     Token name;
     std::shared_ptr<Expr> initializer;
+    mutable int slot = -1; // Slot in its scope, or -1 for a global; set by the Resolver
 };
 
 class While : public Stmt {
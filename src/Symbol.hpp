@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/** Compact id of an interned identifier; equal names always share one id. */
+using SymbolId = uint32_t;
+
+/**
+ * Process-wide table of interned identifier names. Tokens intern their
+ * identifiers once when they are created, so environments, instance fields
+ * and method tables can key on a SymbolId instead of hashing and comparing
+ * strings on every lookup.
+ */
+class SymbolTable {
+public:
+    static SymbolId intern(std::string_view name) {
+        SymbolTable& table = instance();
+        auto it = table.ids.find(name);
+        if (it != table.ids.end()) return it->second;
+        SymbolId id = static_cast<SymbolId>(table.names.size());
+        // Deque elements never move, so the key can view the stored name
+        const std::string& stored = table.names.emplace_back(name);
+        table.ids.emplace(stored, id);
+        return id;
+    }
+
+    static const std::string& name(SymbolId id) {
+        return instance().names[id];
+    }
+
+private:
+    static SymbolTable& instance() {
+        static SymbolTable table;
+        return table;
+    }
+
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, SymbolId> ids;
+};
+
+/** Names the runtime looks up itself. */
+namespace symbols {
+inline const SymbolId THIS = SymbolTable::intern("this");
+inline const SymbolId SUPER = SymbolTable::intern("super");
+inline const SymbolId INIT = SymbolTable::intern("init");
+inline const SymbolId CLOCK = SymbolTable::intern("clock");
+}
@@ -0,0 +1,724 @@
+#include "VM.hpp"
+#include "Compiler.hpp"
+#include "RuntimeError.hpp"
+#include "literal_to_string.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static VMValue clockNative(int, VMValue*) {
+    auto now = std::chrono::system_clock::now();
+    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+    return VMValue::fromNumber(static_cast<double>(millis) / 1000.0);
+}
+
+static bool isCallable(const VMValue& value) {
+    if (!value.isObj()) return false;
+    switch (value.as.obj->type) {
+        case ObjType::CLOSURE:
+        case ObjType::NATIVE:
+        case ObjType::CLASS:
+        case ObjType::BOUND_METHOD:
+            return true;
+        default:
+            return false;
+    }
+}
+
+VM::VM() {
+    // calloc keeps untouched stack pages unmapped, so the large limit costs nothing until used
+    stack = static_cast<VMValue*>(std::calloc(STACK_MAX, sizeof(VMValue)));
+    if (!stack) throw std::bad_alloc();
+    stackTop = stack;
+    stackLimit = stack + STACK_MAX - STACK_SLACK;
+    frames.reserve(64);
+    initString = copyString("init");
+    defineNative("clock", 0, clockNative);
+}
+
+VM::~VM() {
+    Obj* object = objects;
+    while (object) {
+        Obj* next = object->next;
+        delete object;
+        object = next;
+    }
+    std::free(stack);
+}
+
+ObjFunction* VM::compile(const std::vector<std::shared_ptr<Stmt>>& statements) {
+    Compiler compiler(*this);
+    return compiler.compile(statements);
+}
+
+void VM::run(ObjFunction* script) {
+    collecting = true;
+    push(VMValue::fromObj(script));
+    ObjClosure* closure = newClosure(script);
+    stackTop[-1] = VMValue::fromObj(closure);
+    callClosure(closure, 0, stack, stack, false);
+    execute();
+}
+
+uint16_t VM::globalSlot(const std::string& name) {
+    auto it = globalIndices.find(name);
+    if (it != globalIndices.end()) {
+        return it->second;
+    }
+    if (globals.size() > UINT16_MAX) {
+        throw RuntimeError(Token(TokenType::IDENTIFIER, "", std::monostate{}, 0), "Too many global variables.");
+    }
+    uint16_t index = static_cast<uint16_t>(globals.size());
+    globalNames.push_back(copyString(name));
+    globals.push_back(VMValue::undefined());
+    globalIndices.emplace(name, index);
+    return index;
+}
+
+void VM::defineNative(const std::string& name, int arity, NativeFn function) {
+    globals[globalSlot(name)] = VMValue::fromObj(allocate<ObjNative>(function, arity, name));
+}
+
+void VM::execute() {
+    CallFrame* frame = &frames.back();
+    uint8_t* ip = frame->ip;
+    VMValue* slots = frame->slots;
+    VMValue* constants = frame->closure->function->chunk.constants.data();
+
+#define READ_BYTE() (*ip++)
+#define READ_SHORT() (ip += 2, static_cast<uint16_t>((ip[-2] << 8) | ip[-1]))
+#define READ_JUMP() (ip += 4, (static_cast<uint32_t>(ip[-4]) << 24) | (static_cast<uint32_t>(ip[-3]) << 16) | \
+                              (static_cast<uint32_t>(ip[-2]) << 8) | static_cast<uint32_t>(ip[-1]))
+#define READ_STRING() asObj<ObjString>(constants[READ_SHORT()])
+#define LOAD_FRAME() \
+    do { \
+        frame = &frames.back(); \
+        ip = frame->ip; \
+        slots = frame->slots; \
+        constants = frame->closure->function->chunk.constants.data(); \
+    } while (false)
+#define NUMBER_OP(makeValue, op) \
+    { \
+        VMValue b = stackTop[-1]; \
+        VMValue a = stackTop[-2]; \
+        if (a.type != ValueType::NUMBER || b.type != ValueType::NUMBER) { \
+            frame->ip = ip; \
+            numberOperandsError(a, b); \
+        } \
+        stackTop[-2] = makeValue(a.as.number op b.as.number); \
+        --stackTop; \
+    }
+
+    for (;;) {
+        switch (static_cast<OpCode>(READ_BYTE())) {
+            case OpCode::CONSTANT:
+                push(constants[READ_SHORT()]);
+                break;
+            case OpCode::NIL:
+                push(VMValue::nil());
+                break;
+            case OpCode::TRUE:
+                push(VMValue::fromBool(true));
+                break;
+            case OpCode::FALSE:
+                push(VMValue::fromBool(false));
+                break;
+            case OpCode::POP:
+                --stackTop;
+                break;
+            case OpCode::POPN:
+                stackTop -= READ_SHORT();
+                break;
+            case OpCode::GET_LOCAL:
+                push(slots[READ_SHORT()]);
+                break;
+            case OpCode::SET_LOCAL:
+                slots[READ_SHORT()] = stackTop[-1];
+                break;
+            case OpCode::GET_GLOBAL: {
+                uint16_t index = READ_SHORT();
+                VMValue value = globals[index];
+                if (value.isUndefined()) {
+                    frame->ip = ip;
+                    runtimeError("Undefined variable '" + globalNames[index]->chars + "'.");
+                }
+                push(value);
+                break;
+            }
+            case OpCode::DEFINE_GLOBAL:
+                globals[READ_SHORT()] = pop();
+                break;
+            case OpCode::SET_GLOBAL: {
+                uint16_t index = READ_SHORT();
+                if (globals[index].isUndefined()) {
+                    frame->ip = ip;
+                    runtimeError("Undefined variable '" + globalNames[index]->chars + "'.");
+                }
+                globals[index] = stackTop[-1];
+                break;
+            }
+            case OpCode::GET_UPVALUE:
+                push(*frame->closure->upvalues[READ_SHORT()]->location);
+                break;
+            case OpCode::SET_UPVALUE:
+                *frame->closure->upvalues[READ_SHORT()]->location = stackTop[-1];
+                break;
+            case OpCode::GET_PROPERTY: {
+                ObjString* name = READ_STRING();
+                VMValue receiver = stackTop[-1];
+                if (!isObjType(receiver, ObjType::INSTANCE)) {
+                    frame->ip = ip;
+                    runtimeError("Only instances have properties.");
+                }
+                ObjInstance* instance = asObj<ObjInstance>(receiver);
+                auto field = instance->fields.find(name);
+                if (field != instance->fields.end()) {
+                    stackTop[-1] = field->second;
+                    break;
+                }
+                auto method = instance->klass->methods.find(name);
+                if (method == instance->klass->methods.end()) {
+                    frame->ip = ip;
+                    runtimeError("Undefined property '" + name->chars + "'.");
+                }
+                stackTop[-1] = VMValue::fromObj(newBoundMethod(receiver, method->second));
+                break;
+            }
+            case OpCode::SET_PROPERTY: {
+                ObjString* name = READ_STRING();
+                VMValue receiver = stackTop[-2];
+                if (!isObjType(receiver, ObjType::INSTANCE)) {
+                    frame->ip = ip;
+                    runtimeError("Only instances have fields.");
+                }
+                VMValue value = stackTop[-1];
+                asObj<ObjInstance>(receiver)->fields[name] = value;
+                stackTop[-2] = value;
+                --stackTop;
+                break;
+            }
+            case OpCode::CHECK_INSTANCE:
+                if (!isObjType(stackTop[-1], ObjType::INSTANCE)) {
+                    frame->ip = ip;
+                    runtimeError("Only instances have fields.");
+                }
+                break;
+            case OpCode::GET_METHOD: {
+                ObjString* name = READ_STRING();
+                VMValue receiver = stackTop[-1];
+                if (!isObjType(receiver, ObjType::INSTANCE)) {
+                    frame->ip = ip;
+                    runtimeError("Only instances have properties.");
+                }
+                ObjInstance* instance = asObj<ObjInstance>(receiver);
+                auto field = instance->fields.find(name);
+                if (field != instance->fields.end()) {
+                    stackTop[-1] = field->second;
+                    push(VMValue::undefined());
+                    break;
+                }
+                auto method = instance->klass->methods.find(name);
+                if (method == instance->klass->methods.end()) {
+                    frame->ip = ip;
+                    runtimeError("Undefined property '" + name->chars + "'.");
+                }
+                stackTop[-1] = VMValue::fromObj(method->second);
+                push(receiver);
+                break;
+            }
+            case OpCode::GET_SUPER: {
+                ObjString* name = READ_STRING();
+                ObjClass* superclass = asObj<ObjClass>(stackTop[-1]);
+                auto method = superclass->methods.find(name);
+                if (method == superclass->methods.end()) {
+                    frame->ip = ip;
+                    runtimeError("Undefined property '" + name->chars + "'.");
+                }
+                ObjBoundMethod* bound = newBoundMethod(stackTop[-2], method->second);
+                stackTop[-2] = VMValue::fromObj(bound);
+                --stackTop;
+                break;
+            }
+            case OpCode::SUPER_METHOD: {
+                ObjString* name = READ_STRING();
+                ObjClass* superclass = asObj<ObjClass>(stackTop[-1]);
+                auto method = superclass->methods.find(name);
+                if (method == superclass->methods.end()) {
+                    frame->ip = ip;
+                    runtimeError("Undefined property '" + name->chars + "'.");
+                }
+                stackTop[-1] = stackTop[-2];
+                stackTop[-2] = VMValue::fromObj(method->second);
+                break;
+            }
+            case OpCode::EQUAL: {
+                bool equal = valuesEqual(stackTop[-2], stackTop[-1]);
+                stackTop[-2] = VMValue::fromBool(equal);
+                --stackTop;
+                break;
+            }
+            case OpCode::NOT_EQUAL: {
+                bool equal = valuesEqual(stackTop[-2], stackTop[-1]);
+                stackTop[-2] = VMValue::fromBool(!equal);
+                --stackTop;
+                break;
+            }
+            case OpCode::GREATER: NUMBER_OP(VMValue::fromBool, >) break;
+            case OpCode::GREATER_EQUAL: NUMBER_OP(VMValue::fromBool, >=) break;
+            case OpCode::LESS: NUMBER_OP(VMValue::fromBool, <) break;
+            case OpCode::LESS_EQUAL: NUMBER_OP(VMValue::fromBool, <=) break;
+            case OpCode::SUBTRACT: NUMBER_OP(VMValue::fromNumber, -) break;
+            case OpCode::MULTIPLY: NUMBER_OP(VMValue::fromNumber, *) break;
+            case OpCode::DIVIDE: NUMBER_OP(VMValue::fromNumber, /) break;
+            case OpCode::ADD: {
+                VMValue b = stackTop[-1];
+                VMValue a = stackTop[-2];
+                if (a.isNumber() && b.isNumber()) {
+                    stackTop[-2] = VMValue::fromNumber(a.as.number + b.as.number);
+                    --stackTop;
+                    break;
+                }
+                frame->ip = ip;
+                if (isCallable(a) || isCallable(b)) {
+                    runtimeError("Operands must not be functions.");
+                }
+                if (!isObjType(a, ObjType::STRING) || !isObjType(b, ObjType::STRING)) {
+                    runtimeError("Operands must be two numbers or two strings.");
+                }
+                const std::string& left = asObj<ObjString>(a)->chars;
+                const std::string& right = asObj<ObjString>(b)->chars;
+                std::string result;
+                result.reserve(left.size() + right.size());
+                result.append(left).append(right);
+                // Operands stay on the stack until the result exists so a collection can't free them
+                ObjString* concatenated = takeString(std::move(result));
+                stackTop[-2] = VMValue::fromObj(concatenated);
+                --stackTop;
+                break;
+            }
+            case OpCode::NOT:
+                stackTop[-1] = VMValue::fromBool(isFalsey(stackTop[-1]));
+                break;
+            case OpCode::NEGATE:
+                if (!stackTop[-1].isNumber()) {
+                    frame->ip = ip;
+                    runtimeError("Operand must be a number.");
+                }
+                stackTop[-1].as.number = -stackTop[-1].as.number;
+                break;
+            case OpCode::PRINT: {
+                VMValue value = pop();
+                if (isObjType(value, ObjType::STRING)) {
+                    std::cout << asObj<ObjString>(value)->chars << std::endl;
+                } else {
+                    std::cout << valueToString(value) << std::endl;
+                }
+                break;
+            }
+            case OpCode::JUMP: {
+                uint32_t offset = READ_JUMP();
+                ip += offset;
+                break;
+            }
+            case OpCode::JUMP_IF_FALSE: {
+                uint32_t offset = READ_JUMP();
+                if (isFalsey(stackTop[-1])) ip += offset;
+                break;
+            }
+            case OpCode::LOOP: {
+                uint32_t offset = READ_JUMP();
+                ip -= offset;
+                break;
+            }
+            case OpCode::CALL: {
+                int argCount = READ_BYTE();
+                frame->ip = ip;
+                callValue(stackTop[-argCount - 1], argCount);
+                LOAD_FRAME();
+                break;
+            }
+            case OpCode::CALL_METHOD: {
+                int argCount = READ_BYTE();
+                frame->ip = ip;
+                VMValue* callee = stackTop - argCount - 2;
+                if (callee[1].isUndefined()) {
+                    // The name was a field: drop the receiver placeholder and call the value normally
+                    std::memmove(callee + 1, callee + 2, sizeof(VMValue) * argCount);
+                    --stackTop;
+                    callValue(*callee, argCount);
+                } else {
+                    callClosure(asObj<ObjClosure>(*callee), argCount, callee + 1, callee, true);
+                }
+                LOAD_FRAME();
+                break;
+            }
+            case OpCode::CLOSURE: {
+                ObjFunction* function = asObj<ObjFunction>(constants[READ_SHORT()]);
+                ObjClosure* closure = newClosure(function);
+                push(VMValue::fromObj(closure));
+                for (int i = 0; i < function->upvalueCount; ++i) {
+                    uint8_t isLocal = READ_BYTE();
+                    uint16_t index = READ_SHORT();
+                    closure->upvalues[i] = isLocal ? captureUpvalue(slots + index) : frame->closure->upvalues[index];
+                }
+                break;
+            }
+            case OpCode::CLOSE_UPVALUE:
+                closeUpvalues(stackTop - 1);
+                --stackTop;
+                break;
+            case OpCode::RETURN: {
+                if (frame->rebind) {
+                    // A bound method that returns a function hands it back bound to the same receiver
+                    VMValue result = stackTop[-1];
+                    if (isObjType(result, ObjType::CLOSURE)) {
+                        stackTop[-1] = VMValue::fromObj(newBoundMethod(slots[0], asObj<ObjClosure>(result)));
+                    } else if (isObjType(result, ObjType::BOUND_METHOD)) {
+                        stackTop[-1] = VMValue::fromObj(newBoundMethod(slots[0], asObj<ObjBoundMethod>(result)->method));
+                    }
+                }
+                VMValue result = stackTop[-1];
+                closeUpvalues(slots);
+                VMValue* base = frame->base;
+                frames.pop_back();
+                if (frames.empty()) {
+                    stackTop = stack;
+                    return;
+                }
+                stackTop = base;
+                push(result);
+                LOAD_FRAME();
+                break;
+            }
+            case OpCode::CLASS:
+                push(VMValue::fromObj(allocate<ObjClass>(READ_STRING())));
+                break;
+            case OpCode::INHERIT: {
+                VMValue superclass = stackTop[-2];
+                if (!isObjType(superclass, ObjType::CLASS)) {
+                    frame->ip = ip;
+                    runtimeError("Superclass must be a class.");
+                }
+                ObjClass* subclass = asObj<ObjClass>(stackTop[-1]);
+                subclass->methods = asObj<ObjClass>(superclass)->methods;
+                subclass->initializer = asObj<ObjClass>(superclass)->initializer;
+                --stackTop;
+                break;
+            }
+            case OpCode::METHOD: {
+                ObjString* name = READ_STRING();
+                ObjClass* klass = asObj<ObjClass>(stackTop[-2]);
+                ObjClosure* method = asObj<ObjClosure>(stackTop[-1]);
+                klass->methods[name] = method;
+                if (name == initString) klass->initializer = method;
+                --stackTop;
+                break;
+            }
+        }
+    }
+
+#undef READ_BYTE
+#undef READ_SHORT
+#undef READ_JUMP
+#undef READ_STRING
+#undef LOAD_FRAME
+#undef NUMBER_OP
+}
+
+void VM::callValue(VMValue callee, int argCount) {
+    VMValue* calleeSlot = stackTop - argCount - 1;
+    if (callee.isObj()) {
+        switch (callee.as.obj->type) {
+            case ObjType::CLOSURE:
+                callClosure(asObj<ObjClosure>(callee), argCount, calleeSlot, calleeSlot, false);
+                return;
+            case ObjType::BOUND_METHOD: {
+                ObjBoundMethod* bound = asObj<ObjBoundMethod>(callee);
+                *calleeSlot = bound->receiver;
+                callClosure(bound->method, argCount, calleeSlot, calleeSlot, true);
+                return;
+            }
+            case ObjType::CLASS: {
+                ObjClass* klass = asObj<ObjClass>(callee);
+                int arity = klass->initializer ? klass->initializer->function->arity : 0;
+                if (argCount != arity) {
+                    runtimeError("Expected " + std::to_string(arity) + " arguments but got " + std::to_string(argCount) + ".");
+                }
+                *calleeSlot = VMValue::fromObj(allocate<ObjInstance>(klass));
+                if (klass->initializer) {
+                    callClosure(klass->initializer, argCount, calleeSlot, calleeSlot, false);
+                }
+                return;
+            }
+            case ObjType::NATIVE: {
+                ObjNative* native = asObj<ObjNative>(callee);
+                if (argCount != native->arity) {
+                    runtimeError("Expected " + std::to_string(native->arity) + " arguments but got " + std::to_string(argCount) + ".");
+                }
+                VMValue result = native->function(argCount, stackTop - argCount);
+                stackTop = calleeSlot;
+                push(result);
+                return;
+            }
+            default:
+                break;
+        }
+    }
+    runtimeError("Can only call functions and classes.");
+}
+
+void VM::callClosure(ObjClosure* closure, int argCount, VMValue* slots, VMValue* base, bool rebind) {
+    if (argCount != closure->function->arity) {
+        runtimeError("Expected " + std::to_string(closure->function->arity) + " arguments but got " + std::to_string(argCount) + ".");
+    }
+    if (frames.size() >= maxFrames || stackTop > stackLimit) {
+        runtimeError("Stack overflow.");
+    }
+    frames.push_back(CallFrame{closure, closure->function->chunk.code.data(), slots, base, rebind});
+}
+
+ObjUpvalue* VM::captureUpvalue(VMValue* local) {
+    ObjUpvalue* previous = nullptr;
+    ObjUpvalue* upvalue = openUpvalues;
+    while (upvalue != nullptr && upvalue->location > local) {
+        previous = upvalue;
+        upvalue = upvalue->nextOpen;
+    }
+    if (upvalue != nullptr && upvalue->location == local) {
+        return upvalue;
+    }
+    ObjUpvalue* created = allocate<ObjUpvalue>(local);
+    created->nextOpen = upvalue;
+    if (previous == nullptr) {
+        openUpvalues = created;
+    } else {
+        previous->nextOpen = created;
+    }
+    return created;
+}
+
+void VM::closeUpvalues(VMValue* last) {
+    while (openUpvalues != nullptr && openUpvalues->location >= last) {
+        ObjUpvalue* upvalue = openUpvalues;
+        upvalue->closed = *upvalue->location;
+        upvalue->location = &upvalue->closed;
+        openUpvalues = upvalue->nextOpen;
+    }
+}
+
+void VM::runtimeError(const std::string& message) {
+    const CallFrame& frame = frames.back();
+    const Chunk& chunk = frame.closure->function->chunk;
+    size_t offset = static_cast<size_t>(frame.ip - chunk.code.data());
+    int line = offset > 0 ? chunk.lines[offset - 1] : 0;
+    throw RuntimeError(Token(TokenType::IDENTIFIER, "", std::monostate{}, line), message);
+}
+
+void VM::numberOperandsError(const VMValue& a, const VMValue& b) {
+    if (isCallable(a) || isCallable(b)) {
+        runtimeError("Operands must not be functions.");
+    }
+    runtimeError("Operand must be a number.");
+}
+
+std::string VM::valueToString(const VMValue& value) const {
+    switch (value.type) {
+        case ValueType::NIL: return "nil";
+        case ValueType::BOOL: return value.as.boolean ? "true" : "false";
+        case ValueType::NUMBER: return number_to_string(value.as.number);
+        case ValueType::UNDEFINED: return "nil";
+        case ValueType::OBJ: break;
+    }
+    switch (value.as.obj->type) {
+        case ObjType::STRING: return asObj<ObjString>(value)->chars;
+        case ObjType::FUNCTION: {
+            ObjString* name = asObj<ObjFunction>(value)->name;
+            return name ? "<fn " + name->chars + ">" : "<script>";
+        }
+        case ObjType::NATIVE: return "<native fn " + asObj<ObjNative>(value)->name + ">";
+        case ObjType::CLOSURE: return valueToString(VMValue::fromObj(asObj<ObjClosure>(value)->function));
+        case ObjType::UPVALUE: return "upvalue";
+        case ObjType::CLASS: return asObj<ObjClass>(value)->name->chars;
+        case ObjType::INSTANCE: return asObj<ObjInstance>(value)->klass->name->chars + " instance";
+        case ObjType::BOUND_METHOD: return valueToString(VMValue::fromObj(asObj<ObjBoundMethod>(value)->method->function));
+    }
+    return "";
+}
+
+template <typename T, typename... Args>
+T* VM::allocate(Args&&... args) {
+    if (collecting && bytesAllocated > nextGC) {
+        collectGarbage();
+    }
+    T* object = new T(std::forward<Args>(args)...);
+    bytesAllocated += objectSize(object);
+    object->next = objects;
+    objects = object;
+    return object;
+}
+
+ObjString* VM::copyString(std::string_view chars) {
+    auto it = strings.find(chars);
+    if (it != strings.end()) {
+        return it->second;
+    }
+    ObjString* string = allocate<ObjString>(std::string(chars));
+    strings.emplace(std::string_view(string->chars), string);
+    return string;
+}
+
+ObjString* VM::takeString(std::string chars) {
+    return allocate<ObjString>(std::move(chars));
+}
+
+ObjFunction* VM::newFunction(ObjString* name) {
+    return allocate<ObjFunction>(name);
+}
+
+ObjClosure* VM::newClosure(ObjFunction* function) {
+    return allocate<ObjClosure>(function);
+}
+
+ObjBoundMethod* VM::newBoundMethod(VMValue receiver, ObjClosure* method) {
+    return allocate<ObjBoundMethod>(receiver, method);
+}
+
+size_t VM::objectSize(const Obj* object) {
+    switch (object->type) {
+        case ObjType::STRING: return sizeof(ObjString) + static_cast<const ObjString*>(object)->chars.capacity();
+        case ObjType::FUNCTION: return sizeof(ObjFunction);
+        case ObjType::NATIVE: return sizeof(ObjNative);
+        case ObjType::CLOSURE: return sizeof(ObjClosure) + sizeof(ObjUpvalue*) * static_cast<const ObjClosure*>(object)->upvalues.size();
+        case ObjType::UPVALUE: return sizeof(ObjUpvalue);
+        case ObjType::CLASS: return sizeof(ObjClass);
+        case ObjType::INSTANCE: return sizeof(ObjInstance);
+        case ObjType::BOUND_METHOD: return sizeof(ObjBoundMethod);
+    }
+    return 0;
+}
+
+/**
+ * Mark-sweep collection. Roots are the value stack, active closures, open
+ * upvalues and globals; the string table is weak and drops unmarked entries.
+ */
+void VM::collectGarbage() {
+    for (VMValue* slot = stack; slot < stackTop; ++slot) {
+        markValue(*slot);
+    }
+    for (const CallFrame& frame : frames) {
+        markObject(frame.closure);
+    }
+    for (ObjUpvalue* upvalue = openUpvalues; upvalue != nullptr; upvalue = upvalue->nextOpen) {
+        markObject(upvalue);
+    }
+    for (const VMValue& global : globals) {
+        markValue(global);
+    }
+    for (ObjString* name : globalNames) {
+        markObject(name);
+    }
+    markObject(initString);
+
+    while (!grayStack.empty()) {
+        Obj* object = grayStack.back();
+        grayStack.pop_back();
+        blackenObject(object);
+    }
+
+    for (auto it = strings.begin(); it != strings.end();) {
+        if (!it->second->marked) {
+            it = strings.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    Obj* previous = nullptr;
+    Obj* object = objects;
+    while (object != nullptr) {
+        if (object->marked) {
+            object->marked = false;
+            previous = object;
+            object = object->next;
+            continue;
+        }
+        Obj* unreached = object;
+        object = object->next;
+        if (previous != nullptr) {
+            previous->next = object;
+        } else {
+            objects = object;
+        }
+        freeObject(unreached);
+    }
+
+    nextGC = std::max<size_t>(bytesAllocated * 2, 1024 * 1024);
+}
+
+void VM::markValue(const VMValue& value) {
+    if (value.isObj()) markObject(value.as.obj);
+}
+
+void VM::markObject(Obj* object) {
+    if (object == nullptr || object->marked) return;
+    object->marked = true;
+    grayStack.push_back(object);
+}
+
+void VM::blackenObject(Obj* object) {
+    switch (object->type) {
+        case ObjType::STRING:
+        case ObjType::NATIVE:
+            break;
+        case ObjType::FUNCTION: {
+            auto* function = static_cast<ObjFunction*>(object);
+            markObject(function->name);
+            for (const VMValue& constant : function->chunk.constants) {
+                markValue(constant);
+            }
+            break;
+        }
+        case ObjType::CLOSURE: {
+            auto* closure = static_cast<ObjClosure*>(object);
+            markObject(closure->function);
+            for (ObjUpvalue* upvalue : closure->upvalues) {
+                markObject(upvalue);
+            }
+            break;
+        }
+        case ObjType::UPVALUE:
+            markValue(static_cast<ObjUpvalue*>(object)->closed);
+            break;
+        case ObjType::CLASS: {
+            auto* klass = static_cast<ObjClass*>(object);
+            markObject(klass->name);
+            for (const auto& [name, method] : klass->methods) {
+                markObject(name);
+                markObject(method);
+            }
+            markObject(klass->initializer);
+            break;
+        }
+        case ObjType::INSTANCE: {
+            auto* instance = static_cast<ObjInstance*>(object);
+            markObject(instance->klass);
+            for (const auto& [name, value] : instance->fields) {
+                markObject(name);
+                markValue(value);
+            }
+            break;
+        }
+        case ObjType::BOUND_METHOD: {
+            auto* bound = static_cast<ObjBoundMethod*>(object);
+            markValue(bound->receiver);
+            markObject(bound->method);
+            break;
+        }
+    }
+}
+
+void VM::freeObject(Obj* object) {
+    bytesAllocated -= objectSize(object);
+    delete object;
+}
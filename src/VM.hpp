@@ -0,0 +1,102 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Chunk.hpp"
+#include "VMObject.hpp"
+#include "VMValue.hpp"
+#include "Stmt.hpp"
+
+/**
+ * Stack-based bytecode virtual machine. An alternative to the tree-walking
+ * Interpreter: the resolved AST is compiled once into per-function chunks
+ * (see Compiler.hpp) and executed by a single dispatch loop over a
+ * contiguous value stack. Runtime errors are reported as RuntimeError with
+ * the same messages and line numbers the Interpreter produces.
+ */
+class VM {
+public:
+    VM();
+    ~VM();
+    VM(const VM&) = delete;
+    VM& operator=(const VM&) = delete;
+
+    /** Compile a resolved program into the top-level script function. */
+    ObjFunction* compile(const std::vector<std::shared_ptr<Stmt>>& statements);
+
+    /** Execute a compiled script. Throws RuntimeError on failure. */
+    void run(ObjFunction* script);
+
+    /** Return the interned string for the given characters, allocating it if needed. */
+    ObjString* copyString(std::string_view chars);
+
+    ObjFunction* newFunction(ObjString* name);
+
+    /** How deep calls may nest before a call raises "Stack overflow.". */
+    void setMaxFrames(size_t frames) { maxFrames = frames; }
+
+    /** Index of the global variable slot for a name, creating an empty slot on first use. */
+    uint16_t globalSlot(const std::string& name);
+
+private:
+    struct CallFrame {
+        ObjClosure* closure;
+        uint8_t* ip;
+        VMValue* slots;  // Slot 0 holds the callee, or the receiver for methods
+        VMValue* base;   // Where the result goes when the frame returns
+        bool rebind;     // Called as a bound method: returned functions are bound to the receiver
+    };
+
+    static constexpr size_t STACK_MAX = 1 << 22;
+    static constexpr size_t STACK_SLACK = 1 << 17; // Room one frame may use for locals and temporaries
+    static constexpr size_t FRAMES_MAX = 1 << 18;
+
+    void execute();
+    void push(VMValue value) { *stackTop++ = value; }
+    VMValue pop() { return *--stackTop; }
+
+    void callValue(VMValue callee, int argCount);
+    void callClosure(ObjClosure* closure, int argCount, VMValue* slots, VMValue* base, bool rebind);
+    ObjUpvalue* captureUpvalue(VMValue* local);
+    void closeUpvalues(VMValue* last);
+    void defineNative(const std::string& name, int arity, NativeFn function);
+
+    [[noreturn]] void runtimeError(const std::string& message);
+    [[noreturn]] void numberOperandsError(const VMValue& a, const VMValue& b);
+    std::string valueToString(const VMValue& value) const;
+
+    template <typename T, typename... Args>
+    T* allocate(Args&&... args);
+    ObjClosure* newClosure(ObjFunction* function);
+    ObjBoundMethod* newBoundMethod(VMValue receiver, ObjClosure* method);
+    /** Wrap a string built at runtime. Unlike copyString the result is not interned. */
+    ObjString* takeString(std::string chars);
+
+    void collectGarbage();
+    void markValue(const VMValue& value);
+    void markObject(Obj* object);
+    void blackenObject(Obj* object);
+    void freeObject(Obj* object);
+    static size_t objectSize(const Obj* object);
+
+    VMValue* stack;
+    VMValue* stackTop;
+    VMValue* stackLimit;
+    size_t maxFrames = FRAMES_MAX;
+    std::vector<CallFrame> frames;
+    ObjUpvalue* openUpvalues = nullptr;
+
+    std::vector<VMValue> globals;
+    std::vector<ObjString*> globalNames;
+    std::unordered_map<std::string, uint16_t> globalIndices;
+    std::unordered_map<std::string_view, ObjString*> strings;
+    ObjString* initString = nullptr;
+
+    Obj* objects = nullptr;
+    std::vector<Obj*> grayStack;
+    size_t bytesAllocated = 0;
+    size_t nextGC = 1024 * 1024;
+    bool collecting = false; // Disabled while compiling, since compiler-owned objects are not rooted yet
+};
@@ -0,0 +1,128 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Chunk.hpp"
+#include "VMValue.hpp"
+
+enum class ObjType : uint8_t {
+    STRING,
+    FUNCTION,
+    NATIVE,
+    CLOSURE,
+    UPVALUE,
+    CLASS,
+    INSTANCE,
+    BOUND_METHOD
+};
+
+/**
+ * Header shared by every heap object the VM allocates. Objects are linked
+ * into the VM's object list and reclaimed by its mark-sweep collector.
+ */
+class Obj {
+public:
+    explicit Obj(ObjType type) : type(type) {}
+    virtual ~Obj() = default;
+
+    ObjType type;
+    bool marked = false;
+    Obj* next = nullptr;
+};
+
+/**
+ * Immutable string. Literals and identifiers are interned by the VM so names
+ * can be compared by pointer; strings built at runtime are not, which keeps
+ * repeated concatenation from rehashing ever-longer results.
+ */
+class ObjString : public Obj {
+public:
+    explicit ObjString(std::string chars) : Obj(ObjType::STRING), chars(std::move(chars)) {}
+    std::string chars;
+};
+
+/** A compiled function. Only ever reachable from Lox code through an ObjClosure. */
+class ObjFunction : public Obj {
+public:
+    explicit ObjFunction(ObjString* name) : Obj(ObjType::FUNCTION), name(name) {}
+    int arity = 0;
+    int upvalueCount = 0;
+    Chunk chunk;
+    ObjString* name; // nullptr for the top-level script
+};
+
+using NativeFn = VMValue (*)(int argCount, VMValue* args);
+
+class ObjNative : public Obj {
+public:
+    ObjNative(NativeFn function, int arity, std::string name)
+        : Obj(ObjType::NATIVE), function(function), arity(arity), name(std::move(name)) {}
+    NativeFn function;
+    int arity;
+    std::string name;
+};
+
+/** A captured variable. Points into the stack while open and at 'closed' once hoisted. */
+class ObjUpvalue : public Obj {
+public:
+    explicit ObjUpvalue(VMValue* slot) : Obj(ObjType::UPVALUE), location(slot), closed(VMValue::nil()) {}
+    VMValue* location;
+    VMValue closed;
+    ObjUpvalue* nextOpen = nullptr;
+};
+
+class ObjClosure : public Obj {
+public:
+    explicit ObjClosure(ObjFunction* function)
+        : Obj(ObjType::CLOSURE), function(function), upvalues(function->upvalueCount, nullptr) {}
+    ObjFunction* function;
+    std::vector<ObjUpvalue*> upvalues;
+};
+
+/** A class. Inherited methods are copied down when the class is created, so lookup never walks a chain. */
+class ObjClass : public Obj {
+public:
+    explicit ObjClass(ObjString* name) : Obj(ObjType::CLASS), name(name) {}
+    ObjString* name;
+    std::unordered_map<ObjString*, ObjClosure*> methods;
+    ObjClosure* initializer = nullptr;
+};
+
+class ObjInstance : public Obj {
+public:
+    explicit ObjInstance(ObjClass* klass) : Obj(ObjType::INSTANCE), klass(klass) {}
+    ObjClass* klass;
+    std::unordered_map<ObjString*, VMValue> fields;
+};
+
+class ObjBoundMethod : public Obj {
+public:
+    ObjBoundMethod(VMValue receiver, ObjClosure* method)
+        : Obj(ObjType::BOUND_METHOD), receiver(receiver), method(method) {}
+    VMValue receiver;
+    ObjClosure* method;
+};
+
+inline bool isObjType(const VMValue& value, ObjType type) {
+    return value.type == ValueType::OBJ && value.as.obj->type == type;
+}
+
+template <typename T>
+inline T* asObj(const VMValue& value) {
+    return static_cast<T*>(value.as.obj);
+}
+
+/** Lox equality: identity for objects, except that strings compare by content. */
+inline bool valuesEqual(const VMValue& a, const VMValue& b) {
+    if (a.type != b.type) return false;
+    switch (a.type) {
+        case ValueType::NIL: return true;
+        case ValueType::BOOL: return a.as.boolean == b.as.boolean;
+        case ValueType::NUMBER: return a.as.number == b.as.number;
+        case ValueType::UNDEFINED: return true;
+        case ValueType::OBJ: break;
+    }
+    if (a.as.obj == b.as.obj) return true;
+    return a.as.obj->type == ObjType::STRING && b.as.obj->type == ObjType::STRING &&
+           asObj<ObjString>(a)->chars == asObj<ObjString>(b)->chars;
+}
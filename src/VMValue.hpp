@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+
+class Obj;
+
+enum class ValueType : uint8_t {
+    NIL,
+    BOOL,
+    NUMBER,
+    OBJ,
+    UNDEFINED // Empty global slot or missing receiver; never visible to Lox code
+};
+
+/**
+ * A value as seen by the bytecode VM. Kept trivially copyable so the dispatch
+ * loop and the value stack never run constructors or touch reference counts.
+ */
+struct VMValue {
+    ValueType type;
+    union {
+        bool boolean;
+        double number;
+        Obj* obj;
+    } as;
+
+    static VMValue nil() {
+        VMValue value;
+        value.type = ValueType::NIL;
+        value.as.number = 0;
+        return value;
+    }
+
+    static VMValue undefined() {
+        VMValue value;
+        value.type = ValueType::UNDEFINED;
+        value.as.number = 0;
+        return value;
+    }
+
+    static VMValue fromBool(bool boolean) {
+        VMValue value;
+        value.type = ValueType::BOOL;
+        value.as.boolean = boolean;
+        return value;
+    }
+
+    static VMValue fromNumber(double number) {
+        VMValue value;
+        value.type = ValueType::NUMBER;
+        value.as.number = number;
+        return value;
+    }
+
+    static VMValue fromObj(Obj* obj) {
+        VMValue value;
+        value.type = ValueType::OBJ;
+        value.as.obj = obj;
+        return value;
+    }
+
+    bool isNil() const { return type == ValueType::NIL; }
+    bool isBool() const { return type == ValueType::BOOL; }
+    bool isNumber() const { return type == ValueType::NUMBER; }
+    bool isObj() const { return type == ValueType::OBJ; }
+    bool isUndefined() const { return type == ValueType::UNDEFINED; }
+};
+
+/** Lox truthiness: only nil and false are falsey. */
+inline bool isFalsey(const VMValue& value) {
+    return value.type == ValueType::NIL || (value.type == ValueType::BOOL && !value.as.boolean);
+}
@@ -0,0 +1,236 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include "LoxString.hpp"
+#include "Ref.hpp"
+
+class LoxCallable;
+class LoxInstance;
+
+/**
+ * A Lox value packed into 8 bytes (NaN boxing). Numbers are stored as plain
+ * doubles, or as 48-bit integers when they are integral and came from an
+ * integer literal or integer arithmetic. Every other value lives in the
+ * payload of a quiet NaN: nil, false and true as small tags, integers as a
+ * tagged payload, and strings, callables and instances as a pointer to the
+ * object itself, which carries its own reference count. Copying a number,
+ * nil or boolean never touches memory; copying an object bumps a plain
+ * (non-atomic) count, since the interpreter is single-threaded.
+ */
+class Value {
+public:
+    enum class Type : uint8_t { NIL, NUMBER, STRING, BOOL, CALLABLE, INSTANCE };
+
+    Value() : bits(NIL_BITS) {}
+    Value(std::monostate) : bits(NIL_BITS) {}
+    Value(bool boolean) : bits(boolean ? TRUE_BITS : FALSE_BITS) {}
+
+    Value(double number) {
+        // Every NaN is stored as the canonical one so no payload can pass for a tag or pointer
+        if (number != number) {
+            bits = CANONICAL_NAN;
+        } else {
+            std::memcpy(&bits, &number, sizeof number);
+        }
+    }
+
+    Value(std::string_view string) : bits(pointerBits(STRING_TAG, LoxString::create(string))) {}
+    Value(const std::string& string) : Value(std::string_view(string)) {}
+    Value(const char* string) : Value(std::string_view(string)) {}
+    Value(Ref<LoxInstance> instance) : bits(objectBits(INSTANCE_TAG, std::move(instance))) {}
+
+    /** Any LoxCallable subclass other than an instance, which keeps its own type. */
+    template <typename T,
+              std::enable_if_t<std::is_convertible_v<T*, LoxCallable*> && !std::is_convertible_v<T*, LoxInstance*>, int> = 0>
+    Value(Ref<T> callable) : bits(objectBits(CALLABLE_TAG, std::move(callable))) {}
+
+    /** An integral number, kept as a double if it does not fit in 48 bits. */
+    static Value integer(int64_t number) {
+        if (number < MIN_INT || number > MAX_INT) return static_cast<double>(number);
+        Value value;
+        value.bits = QNAN | INT_TAG | (static_cast<uint64_t>(number) & POINTER_MASK);
+        return value;
+    }
+
+    /** Adopt a newly created string, taking over its reference. */
+    static Value adopt(LoxString* string) {
+        Value value;
+        value.bits = pointerBits(STRING_TAG, string);
+        return value;
+    }
+
+    /** Other pointers would silently become booleans. */
+    template <typename T>
+    Value(T*) = delete;
+
+    Value(const Value& other) : bits(other.bits) {
+        retain();
+    }
+
+    Value(Value&& other) noexcept : bits(other.bits) {
+        other.bits = NIL_BITS;
+    }
+
+    Value& operator=(const Value& other) {
+        other.retain();
+        release();
+        bits = other.bits;
+        return *this;
+    }
+
+    Value& operator=(Value&& other) noexcept {
+        if (this != &other) {
+            release();
+            bits = other.bits;
+            other.bits = NIL_BITS;
+        }
+        return *this;
+    }
+
+    ~Value() { release(); }
+
+    Type type() const {
+        if (isNumber()) return Type::NUMBER;
+        if (isObject()) {
+            switch (bits & TAG_MASK) {
+                case STRING_TAG: return Type::STRING;
+                case CALLABLE_TAG: return Type::CALLABLE;
+                default: return Type::INSTANCE;
+            }
+        }
+        return bits == NIL_BITS ? Type::NIL : Type::BOOL;
+    }
+
+    bool isNil() const { return bits == NIL_BITS; }
+    bool isBool() const { return bits == TRUE_BITS || bits == FALSE_BITS; }
+    bool isNumber() const { return isDouble() || isInt(); }
+    bool isInt() const { return (bits & (OBJECT_BITS | TAG_MASK)) == (QNAN | INT_TAG); }
+    bool isString() const { return (bits & (OBJECT_BITS | TAG_MASK)) == (OBJECT_BITS | STRING_TAG); }
+    bool isCallable() const { return (bits & (OBJECT_BITS | TAG_MASK)) == (OBJECT_BITS | CALLABLE_TAG); }
+    bool isInstance() const { return (bits & (OBJECT_BITS | TAG_MASK)) == (OBJECT_BITS | INSTANCE_TAG); }
+
+    double asNumber() const {
+        if (isInt()) return static_cast<double>(asInt());
+        double number;
+        std::memcpy(&number, &bits, sizeof number);
+        return number;
+    }
+
+    /** The integer in the payload, sign-extended from 48 bits. */
+    int64_t asInt() const { return static_cast<int64_t>(bits << 16) >> 16; }
+
+    bool asBool() const { return bits == TRUE_BITS; }
+    std::string_view asString() const { return asLoxString().view(); }
+    const LoxString& asLoxString() const { return *static_cast<LoxString*>(pointer()); }
+    // Defined in LoxCallable.hpp and LoxInstance.hpp, where the types are complete
+    LoxCallable* asCallable() const;
+    LoxInstance* asInstance() const;
+
+    /** The callable or instance, as the base that carries its reference count. */
+    RefCounted* asObject() const { return static_cast<RefCounted*>(pointer()); }
+
+    // Arithmetic on two numbers. Integer operands give an integer result while it is
+    // exact and in range, and a double otherwise, so the result is always the one
+    // double arithmetic would give; -0 has no integer form and stays a double.
+    static Value add(const Value& left, const Value& right) {
+        if (left.isInt() && right.isInt()) return integer(left.asInt() + right.asInt());
+        return left.asNumber() + right.asNumber();
+    }
+
+    static Value subtract(const Value& left, const Value& right) {
+        if (left.isInt() && right.isInt()) return integer(left.asInt() - right.asInt());
+        return left.asNumber() - right.asNumber();
+    }
+
+    static Value multiply(const Value& left, const Value& right) {
+        if (left.isInt() && right.isInt()) {
+            int64_t a = left.asInt();
+            int64_t b = right.asInt();
+            int64_t product;
+            if (!__builtin_mul_overflow(a, b, &product) && (product != 0 || (a >= 0 && b >= 0))) {
+                return integer(product);
+            }
+        }
+        return left.asNumber() * right.asNumber();
+    }
+
+    static Value divide(const Value& left, const Value& right) {
+        return left.asNumber() / right.asNumber();
+    }
+
+    static Value negate(const Value& value) {
+        if (value.isInt() && value.asInt() != 0) return integer(-value.asInt());
+        return -value.asNumber();
+    }
+
+    /** Lox equality: numbers by IEEE value, strings by contents, objects by identity. */
+    friend bool operator==(const Value& left, const Value& right) {
+        if (left.isInt() && right.isInt()) return left.bits == right.bits;
+        if (left.isNumber() && right.isNumber()) return left.asNumber() == right.asNumber();
+        if (left.bits == right.bits) return true;
+        // Callables and instances are equal only when they are the same object, so have the same bits
+        if (left.isString() && right.isString()) return left.asLoxString().equals(right.asLoxString());
+        return false;
+    }
+
+private:
+    static constexpr uint64_t SIGN_BIT = 0x8000000000000000;
+    static constexpr uint64_t QNAN = 0x7ffc000000000000;
+    static constexpr uint64_t CANONICAL_NAN = 0x7ff8000000000000;
+    static constexpr uint64_t NIL_BITS = QNAN | 1;
+    static constexpr uint64_t FALSE_BITS = QNAN | 2;
+    static constexpr uint64_t TRUE_BITS = QNAN | 3;
+    static constexpr uint64_t OBJECT_BITS = SIGN_BIT | QNAN;
+    // The two payload bits above a 48-bit pointer say what it points to; without
+    // the sign bit, INT_TAG there marks a 48-bit integer payload instead
+    static constexpr uint64_t TAG_MASK = 0x0003000000000000;
+    static constexpr uint64_t STRING_TAG = 0x0000000000000000;
+    static constexpr uint64_t CALLABLE_TAG = 0x0001000000000000;
+    static constexpr uint64_t INSTANCE_TAG = 0x0002000000000000;
+    static constexpr uint64_t INT_TAG = 0x0001000000000000;
+    static constexpr uint64_t POINTER_MASK = 0x0000ffffffffffff;
+    static constexpr int64_t MAX_INT = (int64_t{1} << 47) - 1;
+    static constexpr int64_t MIN_INT = -(int64_t{1} << 47);
+
+    static uint64_t pointerBits(uint64_t tag, const void* pointer) {
+        return OBJECT_BITS | tag | reinterpret_cast<uint64_t>(pointer);
+    }
+
+    /** Take over the reference; the payload points at the RefCounted base. */
+    template <typename T>
+    static uint64_t objectBits(uint64_t tag, Ref<T> object) {
+        return pointerBits(tag, static_cast<RefCounted*>(object.detach()));
+    }
+
+    bool isDouble() const { return (bits & QNAN) != QNAN; }
+    bool isObject() const { return (bits & OBJECT_BITS) == OBJECT_BITS; }
+    void* pointer() const { return reinterpret_cast<void*>(bits & POINTER_MASK); }
+
+    void retain() const {
+        if (!isObject()) return;
+        if ((bits & TAG_MASK) == STRING_TAG) {
+            static_cast<LoxString*>(pointer())->retain();
+        } else {
+            asObject()->retain();
+        }
+    }
+
+    void release() {
+        if (!isObject()) return;
+        if ((bits & TAG_MASK) == STRING_TAG) {
+            static_cast<LoxString*>(pointer())->release();
+        } else {
+            asObject()->release();
+        }
+    }
+
+    uint64_t bits;
+};
+
+static_assert(sizeof(Value) == 8, "Value must stay NaN-boxed");
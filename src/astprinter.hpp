@@ -26,26 +26,21 @@ public:
     }
 
     void visit(const Literal& expr) const override {
-        if (!std::holds_alternative<std::monostate>(expr.value)) {
-            auto* valuePtr = const_cast<lox_literal*>(&expr.value);
-            ::std::visit([this](const auto& arg) {
-                using T = std::decay_t<decltype(arg)>;
-                if constexpr (std::is_same_v<T, std::string>) {
-                    oss << arg;
-                } else if constexpr (std::is_same_v<T, double>) {
-                    oss << this->normalizeNumberLiteral(std::to_string(arg));
-                } else if constexpr (std::is_same_v<T, bool>) {
-                    oss << (arg ? "true" : "false");
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<LoxCallable>>) {
-                    oss << "<fn>";
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<LoxInstance>>) {
-                    oss << "<instance>";
-                } else if constexpr (std::is_same_v<T, std::monostate>) {
-                    oss << "nil";
-                } else {
-                    oss << "<unknown>";
-                }
-            }, *valuePtr);
+        if (!expr.value.isNil()) {
+            const lox_literal& value = expr.value;
+            if (value.isString()) {
+                oss << value.asString();
+            } else if (value.isNumber()) {
+                oss << this->normalizeNumberLiteral(std::to_string(value.asNumber()));
+            } else if (value.isBool()) {
+                oss << (value.asBool() ? "true" : "false");
+            } else if (value.isCallable()) {
+                oss << "<fn>";
+            } else if (value.isInstance()) {
+                oss << "<instance>";
+            } else {
+                oss << "<unknown>";
+            }
         } else {
             oss << "nil";
         }
@@ -118,7 +113,7 @@ private:
         return numStr.substr(0, endPos + 1);
     }
 
-    void parenthesize(const std::string& name, const std::vector<ExprPtr>& exprs) const {
+    void parenthesize(std::string_view name, const std::vector<ExprPtr>& exprs) const {
         oss << "(" << name;
         for (const auto& expr : exprs) {
             oss << " ";
@@ -8,13 +8,18 @@
 #include "LoxCallable.hpp"
 #include "LoxClock.hpp"
 #include "LoxFunction.hpp"
-#include "ReturnException.hpp"
+#include "Completion.hpp"
 #include "literal.hpp"
 #include "Stmt.hpp"
 #include<unordered_map>
+#include <optional>
 #include "lox_utils.hpp"
 #include "literal_to_string.hpp"
 #include "LoxClass.hpp"
+#include "CompiledCode.hpp"
+#include "Jit.hpp"
+#include "LoopTracer.hpp"
+#include "CallStack.hpp"
 #include <iostream>
 
 /**
@@ -23,15 +28,44 @@
  * managing execution environments and variable resolution.
  */
 class Interpreter : public ExprVisitorEval, public StmtVisitorEval {
+    /** Declared first so it is destroyed last, once the members below have freed their heap objects. */
+    HeapScope heapScope;
+
 public:
     /**
      * Initialize the interpreter with global environment and built-in functions.
      */
     Interpreter() {
-        globals->define("clock", std::make_shared<LoxClock>());
+        globals->define(symbols::CLOCK, makeRef<LoxClock>());
         environment = globals;
+        setJitEnabled(true);
+        setTracingEnabled(true);
+    }
+
+    /** Drop the environments, then collect the cycles reference counting leaves behind. */
+    ~Interpreter() override {
+        environment.reset();
+        spareFrames.clear();
+        globals.reset();
+        Gc::collect();
     }
 
+    /** Turn the baseline JIT on or off (it is always off where unsupported). */
+    void setJitEnabled(bool enabled) {
+        jit = enabled && Jit::isSupported() ? std::make_unique<Jit>() : nullptr;
+    }
+
+    /** The JIT for hot functions and loops, or nullptr if disabled. */
+    Jit* getJit() const { return jit.get(); }
+
+    /** Turn the trace recorder for hot while loops on or off. */
+    void setTracingEnabled(bool enabled) {
+        tracer = enabled ? std::make_unique<LoopTracer>() : nullptr;
+    }
+
+    /** How deep calls may nest before a call raises "Stack overflow.". */
+    void setMaxCallDepth(size_t depth) { maxCallDepth = depth; }
+
     /** Execute an expression statement and return the result. */
     lox_literal visit(const Expression& stmt) {
         return evaluate(*stmt.expression);
@@ -45,13 +79,9 @@ public:
     }
 
     /** Execute any statement using the visitor pattern. */
-    void execute(Stmt& stmt) {
+    Completion execute(Stmt& stmt) {
         stmt.accept(*this);
-    }
-
-    /** Store the resolved distance for a variable lookup. Called by the Resolver. */
-    void resolve(const Expr* expr, int depth) {
-        locals.emplace(expr, depth);
+        return returning ? Completion::RETURN : Completion::NORMAL;
     }
 
     /** Evaluate any expression using the visitor pattern. */
@@ -61,10 +91,7 @@ public:
 
     /** Return the literal value directly. */
     lox_literal visit(const Literal& expr) override{
-        return std::visit([](auto&& arg) -> lox_literal {
-            using T = std::decay_t<decltype(arg)>;
-            return lox_literal(arg);
-        }, expr.value);
+        return expr.value;
     }
 
     /** Evaluate the grouped expression. */
@@ -74,7 +101,7 @@ public:
 
     /** Look up a variable's value using resolved distance or global scope. */
     lox_literal visit(const Variable& expr) override {
-        return lookUpVariable(expr.name, expr);
+        return lookUpVariable(expr.name, expr.local);
     }
 
     /** Handle logical operators (AND, OR) with short-circuit evaluation. */
@@ -96,64 +123,78 @@ public:
         } else {
             value = std::monostate{};
         }
-        environment->define(stmt.name.getLexeme(), value);
+        defineVariable(stmt.name, stmt.slot, value);
         return std::monostate{};
     }
 
+    /** Bind a declaration in the current environment: in its slot, or by name for a global. */
+    void defineVariable(const Token& name, int slot, const lox_literal& value) {
+        if (slot >= 0) {
+            environment->setSlot(slot, value);
+        } else {
+            environment->define(name.getSymbol(), value);
+        }
+    }
+
     /** Handle binary operators (+, -, *, /, ==, !=, <, >, <=, >=). */
     lox_literal visit(const Binary& expr) override {
         lox_literal left = evaluate(*expr.left);
         lox_literal right = evaluate(*expr.right);
-        switch(expr.op.getTokenType()){
+        return applyBinary(expr.op, left, right);
+    }
+
+    /** Apply a binary operator to already-evaluated operands. Shared with the ClosureCompiler. */
+    static lox_literal applyBinary(const Token& op, const lox_literal& left, const lox_literal& right) {
+        switch(op.getTokenType()){
             case TokenType::PLUS:
-                if(std::holds_alternative<std::shared_ptr<LoxCallable>>(left) || std::holds_alternative<std::shared_ptr<LoxCallable>>(right))
-                    throw RuntimeError(expr.op, "Operands must not be functions.");
-                if(std::holds_alternative<double>(left) && std::holds_alternative<double>(right)){
-                    return std::get<double>(left) + std::get<double>(right);
+                if(left.isCallable() || right.isCallable())
+                    throw RuntimeError(op, "Operands must not be functions.");
+                if(left.isNumber() && right.isNumber()){
+                    return Value::add(left, right);
                 }
-                if(std::holds_alternative<std::string>(left) && std::holds_alternative<std::string>(right)){
-                    return std::get<std::string>(left) + std::get<std::string>(right);
+                if(left.isString() && right.isString()){
+                    return Value::adopt(LoxString::concat(left.asLoxString(), right.asLoxString()));
                 }
-                throw RuntimeError(expr.op, "Operands must be two numbers or two strings.");
+                throw RuntimeError(op, "Operands must be two numbers or two strings.");
             case TokenType::MINUS:
-                if(std::holds_alternative<std::shared_ptr<LoxCallable>>(left) || std::holds_alternative<std::shared_ptr<LoxCallable>>(right))
-                    throw RuntimeError(expr.op, "Operands must not be functions.");
-                checkNumberOperand(expr.op, {left, right});
-                return std::get<double>(left) - std::get<double>(right);
+                if(left.isCallable() || right.isCallable())
+                    throw RuntimeError(op, "Operands must not be functions.");
+                checkNumberOperand(op, {left, right});
+                return Value::subtract(left, right);
             case TokenType::STAR:
-                if(std::holds_alternative<std::shared_ptr<LoxCallable>>(left) || std::holds_alternative<std::shared_ptr<LoxCallable>>(right))
-                    throw RuntimeError(expr.op, "Operands must not be functions.");
-                checkNumberOperand(expr.op, {left, right});
-                return std::get<double>(left) * std::get<double>(right);
+                if(left.isCallable() || right.isCallable())
+                    throw RuntimeError(op, "Operands must not be functions.");
+                checkNumberOperand(op, {left, right});
+                return Value::multiply(left, right);
             case TokenType::SLASH:
-                if(std::holds_alternative<std::shared_ptr<LoxCallable>>(left) || std::holds_alternative<std::shared_ptr<LoxCallable>>(right))
-                    throw RuntimeError(expr.op, "Operands must not be functions.");
-                checkNumberOperand(expr.op, {left, right});
-                return std::get<double>(left) / std::get<double>(right);
+                if(left.isCallable() || right.isCallable())
+                    throw RuntimeError(op, "Operands must not be functions.");
+                checkNumberOperand(op, {left, right});
+                return Value::divide(left, right);
             case TokenType::EQUAL_EQUAL:
                 return left == right;
             case TokenType::BANG_EQUAL:
                 return left != right;
             case TokenType::GREATER:
-                if(std::holds_alternative<std::shared_ptr<LoxCallable>>(left) || std::holds_alternative<std::shared_ptr<LoxCallable>>(right))
-                    throw RuntimeError(expr.op, "Operands must not be functions.");
-                checkNumberOperand(expr.op, {left, right});
-                return std::get<double>(left) > std::get<double>(right);
+                if(left.isCallable() || right.isCallable())
+                    throw RuntimeError(op, "Operands must not be functions.");
+                checkNumberOperand(op, {left, right});
+                return left.asNumber() > right.asNumber();
             case TokenType::GREATER_EQUAL:
-                if(std::holds_alternative<std::shared_ptr<LoxCallable>>(left) || std::holds_alternative<std::shared_ptr<LoxCallable>>(right))
-                    throw RuntimeError(expr.op, "Operands must not be functions.");
-                checkNumberOperand(expr.op, {left, right});
-                return std::get<double>(left) >= std::get<double>(right);
+                if(left.isCallable() || right.isCallable())
+                    throw RuntimeError(op, "Operands must not be functions.");
+                checkNumberOperand(op, {left, right});
+                return left.asNumber() >= right.asNumber();
             case TokenType::LESS:
-                if(std::holds_alternative<std::shared_ptr<LoxCallable>>(left) || std::holds_alternative<std::shared_ptr<LoxCallable>>(right))
-                    throw RuntimeError(expr.op, "Operands must not be functions.");
-                checkNumberOperand(expr.op, {left, right});
-                return std::get<double>(left) < std::get<double>(right);
+                if(left.isCallable() || right.isCallable())
+                    throw RuntimeError(op, "Operands must not be functions.");
+                checkNumberOperand(op, {left, right});
+                return left.asNumber() < right.asNumber();
             case TokenType::LESS_EQUAL:
-                if(std::holds_alternative<std::shared_ptr<LoxCallable>>(left) || std::holds_alternative<std::shared_ptr<LoxCallable>>(right))
-                    throw RuntimeError(expr.op, "Operands must not be functions.");
-                checkNumberOperand(expr.op, {left, right});
-                return std::get<double>(left) <= std::get<double>(right);
+                if(left.isCallable() || right.isCallable())
+                    throw RuntimeError(op, "Operands must not be functions.");
+                checkNumberOperand(op, {left, right});
+                return left.asNumber() <= right.asNumber();
         }
         return std::monostate{};
     }
@@ -161,10 +202,15 @@ public:
     /** Handle unary operators (-, !). */
     lox_literal visit(const Unary& expr) override {
         lox_literal right = evaluate(*expr.right);
-        switch(expr.op.getTokenType()){
+        return applyUnary(expr.op, right);
+    }
+
+    /** Apply a unary operator to an already-evaluated operand. Shared with the ClosureCompiler. */
+    static lox_literal applyUnary(const Token& op, const lox_literal& right) {
+        switch(op.getTokenType()){
             case TokenType::MINUS:
-                checkNumberOperand(expr.op, {right});
-                return -(std::get<double>(right));
+                checkNumberOperand(op, {right});
+                return Value::negate(right);
             case TokenType::BANG:
                 return !isTruthy(right);
         }  
@@ -174,10 +220,8 @@ public:
     /** Assign a value to a variable, using resolved distance if available. */
     lox_literal visit(const Assign& expr) override {
         lox_literal value = evaluate(*expr.value);
-        auto it = locals.find(&expr);
-        if (it != locals.end()) {
-            int distance = static_cast<int>(it->second);
-            environment->assignAt(distance, expr.name, value);
+        if (!expr.local.isGlobal()) {
+            environment->assignAt(expr.local.depth, expr.local.slot, value);
         } else {
             globals->assign(expr.name, value);
         }
@@ -189,32 +233,84 @@ public:
      * a method returns a closure that should be bound to the same instance.
      */
     lox_literal visit(const Call& expr) override {
+        if (expr.method) {
+            MethodCallee callee = lookUpMethod(expr.method->name, evaluate(*expr.method->object), expr.method->cache);
+            std::vector<lox_literal> arguments;
+            for (const auto& arg : expr.arguments) {
+                arguments.push_back(evaluate(*arg));
+            }
+            return callMethod(expr.paren, callee, arguments);
+        }
+
         lox_literal callee = evaluate(*expr.callee);
         std::vector<lox_literal> arguments;
 
         for(const auto& arg : expr.arguments){
             arguments.push_back(evaluate(*arg));
         }
-        if(!std::holds_alternative<std::shared_ptr<LoxCallable>>(callee)){
-            throw RuntimeError(expr.paren, "Can only call functions and classes.");
+        return callValue(expr.paren, callee, arguments);
+    }
+
+    /**
+     * The callee of obj.name(...), looked up before the arguments are
+     * evaluated but not bound to obj: a method of the receiver's class, or
+     * the value of a field.
+     */
+    struct MethodCallee {
+        Ref<LoxInstance> receiver;
+        LoxFunction* method = nullptr; // Kept alive by the receiver's class
+        lox_literal field;             // The callee when the property is a field
+    };
+
+    MethodCallee lookUpMethod(const Token& name, const lox_literal& object, GetCache& cache) {
+        if (!object.isInstance()) {
+            throw RuntimeError(name, "Only instances have properties.");
+        }
+        MethodCallee callee;
+        callee.receiver = Ref<LoxInstance>(object.asInstance());
+        callee.method = callee.receiver->findProperty(name, cache, callee.field);
+        return callee;
+    }
+
+    /**
+     * Finish obj.name(arguments). A method runs with the receiver in its
+     * 'this' slot, so no bound method is allocated unless it escapes as a
+     * value; a field is called like any other value.
+     */
+    lox_literal callMethod(const Token& paren, const MethodCallee& callee, const std::vector<lox_literal>& arguments) {
+        if (!callee.method) {
+            return callValue(paren, callee.field, arguments);
         }
-        auto functionPtr = std::get_if<std::shared_ptr<LoxCallable>>(&callee);
-        if(functionPtr == nullptr || !(*functionPtr)){
-            throw RuntimeError(expr.paren, "Undefined function.");
+        checkArity(paren, *callee.method, arguments);
+        CallDepth depth(*this, paren);
+        lox_literal result = callee.method->callMethod(*this, callee.receiver, arguments);
+
+        // As in callValue: a function returned from a method is bound to the same instance
+        if (result.isCallable()) {
+            if (auto returnedLoxFunc = dynamic_cast<LoxFunction*>(result.asCallable())) {
+                return returnedLoxFunc->bind(callee.receiver);
+            }
         }
-        if(arguments.size() != (*functionPtr)->arity()){
-            throw RuntimeError(expr.paren, "Expected " + std::to_string((*functionPtr)->arity()) + " arguments but got " + std::to_string(arguments.size()) + ".");
+        return result;
+    }
+
+    /** Call an already-evaluated callee. Shared with the ClosureCompiler. */
+    lox_literal callValue(const Token& paren, const lox_literal& callee, const std::vector<lox_literal>& arguments) {
+        if(!callee.isCallable()){
+            throw RuntimeError(paren, "Can only call functions and classes.");
         }
+        LoxCallable* function = callee.asCallable();
+        checkArity(paren, *function, arguments);
 
-        lox_literal result = (*functionPtr)->call(*this, arguments);
+        CallDepth depth(*this, paren);
+        lox_literal result = function->call(*this, arguments);
         
         // Special handling for closures returned from methods:
         // If a bound method returns a function, bind that function to the same instance.
         // This ensures that closures using 'super' or 'this' work correctly.
-        if (std::holds_alternative<std::shared_ptr<LoxCallable>>(result)) {
-            auto returnedFunc = std::get<std::shared_ptr<LoxCallable>>(result);
-            auto returnedLoxFunc = std::dynamic_pointer_cast<LoxFunction>(returnedFunc);
-            auto calleeLoxFunc = std::dynamic_pointer_cast<LoxFunction>(*functionPtr);
+        if (result.isCallable()) {
+            auto returnedLoxFunc = dynamic_cast<LoxFunction*>(result.asCallable());
+            auto calleeLoxFunc = dynamic_cast<LoxFunction*>(function);
             if (returnedLoxFunc && calleeLoxFunc && calleeLoxFunc->getBoundInstance()) {
                 return returnedLoxFunc->bind(calleeLoxFunc->getBoundInstance());
             }
@@ -222,32 +318,78 @@ public:
         return result;
     }
 
+    /** A Lox function called in tail position, waiting for the call it was returned from to finish. */
+    struct TailCall {
+        Ref<LoxFunction> function;
+        Ref<LoxInstance> receiver;
+        std::vector<lox_literal> arguments;
+    };
+
+    /**
+     * 'return callee(arguments)'. A Lox function is not called here but left
+     * pending, so the call returning it can give up its frame first and then
+     * run it in place (see LoxFunction::callMethod); tail recursion therefore
+     * takes no stack. Anything else is called as usual. Shared with the
+     * ClosureCompiler and compiled programs.
+     */
+    Completion tailCallValue(const Token& paren, const lox_literal& callee, std::vector<lox_literal> arguments) {
+        if (!callee.isCallable()) {
+            throw RuntimeError(paren, "Can only call functions and classes.");
+        }
+        LoxCallable* function = callee.asCallable();
+        checkArity(paren, *function, arguments);
+        auto loxFunction = dynamic_cast<LoxFunction*>(function);
+        if (!loxFunction) {
+            CallDepth depth(*this, paren);
+            return returnWith(function->call(*this, arguments));
+        }
+        pendingTailCall = TailCall{Ref<LoxFunction>(loxFunction), loxFunction->getBoundInstance(), std::move(arguments)};
+        return Completion::RETURN;
+    }
+
+    /** 'return obj.name(arguments)', left pending like tailCallValue. */
+    Completion tailCallMethod(const Token& paren, const MethodCallee& callee, std::vector<lox_literal> arguments) {
+        if (!callee.method) {
+            return tailCallValue(paren, callee.field, std::move(arguments));
+        }
+        checkArity(paren, *callee.method, arguments);
+        pendingTailCall = TailCall{Ref<LoxFunction>(callee.method), callee.receiver, std::move(arguments)};
+        return Completion::RETURN;
+    }
+
+    /** Move the pending tail call, if there is one, into `call`. */
+    bool takeTailCall(TailCall& call) {
+        if (!pendingTailCall.function) return false;
+        call = std::exchange(pendingTailCall, TailCall{});
+        return true;
+    }
+
     /** Get a property from an instance (instance.property). */
     lox_literal visit(const Get& expr) override {
         lox_literal object = evaluate(*expr.object);
-        if(!std::holds_alternative<std::shared_ptr<LoxInstance>>(object)){
+        if(!object.isInstance()){
             throw RuntimeError(expr.name, "Only instances have properties.");
         }
-        auto instance = std::get<std::shared_ptr<LoxInstance>>(object);
-        lox_literal value = instance->get(expr.name);
+        auto instance = object.asInstance();
+        lox_literal value = instance->get(expr.name, expr.cache);
         return value;
     }
 
     /** Set a property on an instance (instance.property = value). */
     lox_literal visit(const Set& expr) override {
         lox_literal object = evaluate(*expr.object);
-        if(!std::holds_alternative<std::shared_ptr<LoxInstance>>(object)){
+        if(!object.isInstance()){
             throw RuntimeError(expr.name, "Only instances have fields.");
         }
         lox_literal value = evaluate(*expr.value);
-        auto instance = std::get<std::shared_ptr<LoxInstance>>(object);
-        instance->set(expr.name, value);
+        auto instance = object.asInstance();
+        instance->set(expr.name, value, expr.cache);
         return value;
     }
 
     /** Look up 'this' reference using resolved distance. */
     lox_literal visit(const This& expr) override {
-        return lookUpVariable(expr.keyword, expr);
+        return lookUpVariable(expr.keyword, expr.local);
     }
 
     /** 
@@ -256,94 +398,182 @@ public:
      * 'this' in the execution environment.
      */
     lox_literal visit(const Super& expr) override {
-        int distance = locals.at(&expr);
-        auto superclass = environment->getAt(distance, "super");
+        return superMethod(expr.local.depth, expr.method);
+    }
+
+    /** Bind the superclass method found 'super' hops away to the current 'this'. */
+    lox_literal superMethod(int distance, const Token& methodName) {
+        auto superclass = environment->getAt(distance, 0);
         
-        // Look for 'this' in the execution environment (distance 0)
-        // This works for both direct method calls and closures
-        auto instance = environment->getAt(0, "this");
+        // 'super' lives just outside the class's 'this' scope, which encloses the
+        // method's own scope; the bound instance is in slot 0 of the latter
+        auto instance = environment->getAt(distance - 2, 0);
         
-        auto superclassPtr = std::get<std::shared_ptr<LoxCallable>>(superclass);
-        auto loxClass = std::dynamic_pointer_cast<LoxClass>(superclassPtr);
+        auto loxClass = dynamic_cast<LoxClass*>(superclass.asCallable());
         if (!loxClass) {
-            throw RuntimeError(expr.method, "Superclass is not a class.");
+            throw RuntimeError(methodName, "Superclass is not a class.");
         }
         
-        auto method = loxClass->findMethod(expr.method.getLexeme());
+        auto method = loxClass->findMethod(methodName.getSymbol());
         if (!method) {
-            throw RuntimeError(expr.method, "Undefined property '" + expr.method.getLexeme() + "'.");
+            throw RuntimeError(methodName, "Undefined property '" + std::string(methodName.getLexeme()) + "'.");
         }
         
-        auto instancePtr = std::get<std::shared_ptr<LoxInstance>>(instance);
-        return method->bind(instancePtr);
+        return method->bind(Ref<LoxInstance>(instance.asInstance()));
     }
 
     /** Create a function and store it in the current environment. */
     lox_literal visit(const Function& stmt) override {
-        auto function = std::make_shared<LoxFunction>(std::make_shared<Function>(stmt), environment, false);
-        environment->define(stmt.name.getLexeme(), function);
+        auto function = makeRef<LoxFunction>(Heap::make<Function>(stmt), environment, false);
+        defineVariable(stmt.name, stmt.slot, function);
         return std::monostate{};
     }
 
-    /** Handle return statements by throwing a special exception. */
+    /** Hold the value for the enclosing call; execute() reports RETURN until the call takes it. */
     lox_literal visit(const Return& stmt) override {
+        if (stmt.tailCall) {
+            tailCall(static_cast<const Call&>(*stmt.value));
+            returning = true;
+            return std::monostate{};
+        }
         lox_literal value = std::monostate{};
         if (stmt.value != nullptr) {
             value = evaluate(*stmt.value);
         }
-        throw ReturnException(value);
+        returnWith(value);
+        returning = true;
+        return std::monostate{};
+    }
+
+    /** The call of a 'return' statement the Resolver marked as a tail call. */
+    Completion tailCall(const Call& expr) {
+        if (expr.method) {
+            MethodCallee callee = lookUpMethod(expr.method->name, evaluate(*expr.method->object), expr.method->cache);
+            std::vector<lox_literal> arguments;
+            for (const auto& arg : expr.arguments) {
+                arguments.push_back(evaluate(*arg));
+            }
+            return tailCallMethod(expr.paren, callee, std::move(arguments));
+        }
+        lox_literal callee = evaluate(*expr.callee);
+        std::vector<lox_literal> arguments;
+        for (const auto& arg : expr.arguments) {
+            arguments.push_back(evaluate(*arg));
+        }
+        return tailCallValue(expr.paren, callee, std::move(arguments));
+    }
+
+    /** Hold a 'return' statement's value for the call it returns from. */
+    Completion returnWith(const lox_literal& value) {
+        returnValue = value;
+        return Completion::RETURN;
+    }
+
+    /** The value of the 'return' that finished a call's body, which stops reporting RETURN. */
+    lox_literal takeReturnValue() {
+        returning = false;
+        return std::exchange(returnValue, lox_literal());
     }
 
     /** Execute a block with a new environment scope. */
     lox_literal visit(const Block& stmt) override {
-        auto newEnv = std::make_shared<Environment>(environment);
-        executeBlock(stmt.statements, newEnv);
+        if (stmt.captured) {
+            executeBlock(stmt.statements, makeRef<Environment>(environment, stmt.slotCount));
+            return std::monostate{};
+        }
+        auto frame = acquireFrame(environment, stmt.slotCount);
+        executeBlock(stmt.statements, frame);
+        releaseFrame(std::move(frame));
         return std::monostate{};
     }
 
+    /**
+     * An Environment for a scope no closure captures (see Resolver), taken
+     * from the frames of scopes that have already exited when there is one,
+     * so blocks and calls in a loop do not allocate.
+     */
+    Ref<Environment> acquireFrame(Ref<Environment> enclosing, size_t slotCount) {
+        if (spareFrames.empty()) {
+            return makeRef<Environment>(std::move(enclosing), slotCount);
+        }
+        Ref<Environment> frame = std::move(spareFrames.back());
+        spareFrames.pop_back();
+        frame->reset(std::move(enclosing), slotCount);
+        return frame;
+    }
+
+    /** Hand back an acquired frame once its scope has exited. */
+    void releaseFrame(Ref<Environment>&& frame) {
+        // Anything still holding the frame keeps it; it is freed as usual
+        if (frame->references() != 1 || spareFrames.size() >= MAX_SPARE_FRAMES) return;
+        frame->clear();
+        spareFrames.push_back(std::move(frame));
+    }
+
     /**
      * Define a class with inheritance support. Creates proper environment 
      * chains for 'super' and 'this' binding in methods.
      */
     lox_literal visit(const Class& stmt) override {
-        lox_literal supperClass = std::monostate{};
-        std::shared_ptr<LoxClass> superClassPtr = nullptr;
+        defineClass(stmt, nullptr);
+        return std::monostate{};
+    }
+
+    /**
+     * Create a class in the current environment. When the ClosureCompiler
+     * supplies pre-compiled method bodies (parallel to stmt.methods), the
+     * methods run those instead of walking their AST.
+     */
+    void defineClass(const Class& stmt, const std::vector<std::shared_ptr<CompiledBody>>* compiledMethods) {
+        std::optional<lox_literal> superclass;
         if (stmt.superclass) {
-            supperClass = evaluate(**stmt.superclass);
-            if (!std::holds_alternative<std::shared_ptr<LoxCallable>>(supperClass)) {
-                throw RuntimeError(stmt.name, "Superclass must be a class.");
+            superclass = evaluate(**stmt.superclass);
+        }
+        createClass(stmt.name, stmt.slot, superclass, stmt.methods, compiledMethods);
+    }
+
+    /** Create a class from an already-evaluated superclass (if any) and its method declarations. */
+    void createClass(const Token& name, int slot, const std::optional<lox_literal>& superclass,
+                     const std::vector<std::shared_ptr<Function>>& methodDeclarations,
+                     const std::vector<std::shared_ptr<CompiledBody>>* compiledMethods) {
+        Ref<LoxClass> superClassPtr = nullptr;
+        if (superclass) {
+            if (!superclass->isCallable()) {
+                throw RuntimeError(name, "Superclass must be a class.");
             }
-            superClassPtr = std::dynamic_pointer_cast<LoxClass>(std::get<std::shared_ptr<LoxCallable>>(supperClass));
+            superClassPtr = Ref<LoxClass>(dynamic_cast<LoxClass*>(superclass->asCallable()));
             if (!superClassPtr) {
-                throw RuntimeError(stmt.name, "Superclass must be a class.");
+                throw RuntimeError(name, "Superclass must be a class.");
             }
         }
 
-        environment->define(stmt.name.getLexeme(), std::monostate{});
+        defineVariable(name, slot, std::monostate{});
         
-        std::shared_ptr<Environment> classEnvironment = environment;
+        Ref<Environment> classEnvironment = environment;
         
         // Create environment for 'super' if there's a superclass
-        if (stmt.superclass) {
-            environment = std::make_shared<Environment>(classEnvironment);
-            environment->define("super", superClassPtr);
+        if (superclass) {
+            environment = makeRef<Environment>(classEnvironment, 1);
+            environment->setSlot(0, superClassPtr);
         }
         
         // Create environment for 'this' - methods will capture this environment
-        std::shared_ptr<Environment> methodClosureEnv = std::make_shared<Environment>(environment);
-        methodClosureEnv->define("this", std::monostate{});
+        Ref<Environment> methodClosureEnv = makeRef<Environment>(environment, 1);
         
-        std::unordered_map<std::string, std::shared_ptr<LoxFunction>> methods;
-        for(const auto& method : stmt.methods) {
-            auto function = std::make_shared<LoxFunction>(method, methodClosureEnv, method->name.getLexeme() == "init");
-            methods[method->name.getLexeme()] = function;
+        LoxClass::MethodTable methods;
+        for(size_t i = 0; i < methodDeclarations.size(); ++i) {
+            const auto& method = methodDeclarations[i];
+            auto function = makeRef<LoxFunction>(method, methodClosureEnv, method->name.getSymbol() == symbols::INIT);
+            if (compiledMethods) {
+                function->setCompiledBody((*compiledMethods)[i]);
+            }
+            methods[method->name.getSymbol()] = function;
         }
         
         environment = classEnvironment;
         
-        std::shared_ptr<LoxCallable> klass = LoxClass::create(stmt.name.getLexeme(), std::weak_ptr<LoxClass>(superClassPtr), methods);
-        environment->define(stmt.name.getLexeme(), klass);
-        return std::monostate{};
+        Ref<LoxClass> klass = LoxClass::create(std::string(name.getLexeme()), superClassPtr, methods);
+        defineVariable(name, slot, klass);
     }
 
     /** Execute if statement with optional else branch. */
@@ -360,7 +590,9 @@ public:
     /** Execute while loop. */
     lox_literal visit(const While& stmt) override {
         while (isTruthy(evaluate(*stmt.condition))) {
-            execute(*stmt.body);
+            if (execute(*stmt.body) == Completion::RETURN) break;
+            if (jit && jit->onBackEdge(*this, stmt)) break;
+            if (tracer && tracer->onBackEdge(*this, stmt)) break;
         }
         return std::monostate{};
     }
@@ -369,21 +601,20 @@ public:
      * Look up a variable by name, using resolved distance if available,
      * otherwise searching in global scope.
      */
-    lox_literal lookUpVariable(const Token& name, const Expr& expr) const {
-        auto it = locals.find(&expr);
-        if (it != locals.end()) {
-            int distance = it->second;
-            return environment->getAt(distance, name.getLexeme());
+    lox_literal lookUpVariable(const Token& name, const LocalSlot& local) const {
+        if (!local.isGlobal()) {
+            return environment->getAt(local.depth, local.slot);
         } else {
             return globals->getValue(name);
         }
     }
 
     /** 
-     * Execute a block of statements in a new environment scope.
-     * Properly handles exceptions and restores the previous environment.
+     * Execute a block of statements in a new environment scope, stopping
+     * early if one returns, and restore the previous environment.
      */
-    void executeBlock(const std::vector<std::shared_ptr<Stmt>>& statements, std::shared_ptr<Environment> newEnvironment) {
+    Completion executeBlock(const std::vector<std::shared_ptr<Stmt>>& statements, Ref<Environment> newEnvironment) {
+        collectGarbageIfNeeded();
         auto previousEnvironment = this->environment;
 
         if (previousEnvironment && !newEnvironment->getEnclosing()) {
@@ -392,22 +623,48 @@ public:
 
         this->environment = newEnvironment;
 
-        try {
-            for (size_t i = 0; i < statements.size(); ++i) {
-                execute(*statements[i]);
-            }
-        } catch (const ReturnException&) {
-            this->environment = previousEnvironment;
-            throw;
+        Completion completion = Completion::NORMAL;
+        for (size_t i = 0; i < statements.size(); ++i) {
+            completion = execute(*statements[i]);
+            if (completion == Completion::RETURN) break;
+        }
+
+        this->environment = previousEnvironment;
+        return completion;
+    }
+
+    /**
+     * Execute pre-compiled statements in a new environment scope. The
+     * ClosureCompiler's counterpart to executeBlock.
+     */
+    Completion executeCompiled(const std::vector<CompiledStmt>& statements, Ref<Environment> newEnvironment) {
+        collectGarbageIfNeeded();
+        auto previousEnvironment = this->environment;
+        this->environment = std::move(newEnvironment);
+
+        Completion completion = Completion::NORMAL;
+        for (const auto& statement : statements) {
+            completion = statement(*this);
+            if (completion == Completion::RETURN) break;
         }
 
         this->environment = previousEnvironment;
+        return completion;
+    }
+
+    /**
+     * A safe point: free unreachable cycles if enough objects have been
+     * allocated since the last collection. Everything the evaluator is
+     * working on is held by a counted reference here, so it survives.
+     */
+    void collectGarbageIfNeeded() {
+        if (Gc::shouldCollect()) Gc::collect({globals.get(), environment.get()});
     }
 
     /** Get the depth of the current environment chain (for debugging). */
     int getEnvironmentDepth() const {
         int depth = 0;
-        std::shared_ptr<Environment> env = environment;
+        Ref<Environment> env = environment;
         while (env) {
             depth++;
             env = env->getEnclosing();
@@ -426,22 +683,64 @@ public:
     }
 
     /** Get the current environment (used by LoxFunction). */
-    std::shared_ptr<Environment> getCurrentEnvironment() const {
+    Ref<Environment> getCurrentEnvironment() const {
         return environment;
     }
     
     /** Set the current environment (used by LoxFunction). */
-    void setCurrentEnvironment(std::shared_ptr<Environment> env) {
+    void setCurrentEnvironment(Ref<Environment> env) {
         environment = env;
     }
 
 private:
+    friend class ClosureCompiler;
+    friend class Jit;
+    friend class LoopTracer;
+    friend class AotRuntime;
+
+    /** Counts a call for as long as it runs; one past the maximum depth is a stack overflow. */
+    class CallDepth {
+    public:
+        CallDepth(Interpreter& in, const Token& paren) : in(in) {
+            if (in.callDepth >= in.maxCallDepth || CallStack::exhausted()) {
+                throw RuntimeError(paren, "Stack overflow.");
+            }
+            ++in.callDepth;
+        }
+        ~CallDepth() { --in.callDepth; }
+        CallDepth(const CallDepth&) = delete;
+        CallDepth& operator=(const CallDepth&) = delete;
+
+    private:
+        Interpreter& in;
+    };
+
+    static void checkArity(const Token& paren, const LoxCallable& function, const std::vector<lox_literal>& arguments) {
+        if (arguments.size() != function.arity()) {
+            throw RuntimeError(paren, "Expected " + std::to_string(function.arity()) + " arguments but got " + std::to_string(arguments.size()) + ".");
+        }
+    }
+
     /** Global environment containing built-in functions. */
-    std::shared_ptr<Environment> globals = std::make_shared<Environment>();
+    Ref<Environment> globals = makeRef<Environment>();
     /** Current execution environment. */
-    mutable std::shared_ptr<Environment> environment = globals;
-    /** Map of expressions to their resolved variable distances. */
-    mutable std::unordered_map<const Expr*, int> locals;
+    mutable Ref<Environment> environment = globals;
+    /** Environments of exited uncaptured scopes, ready for acquireFrame to reuse. */
+    std::vector<Ref<Environment>> spareFrames;
+    static constexpr size_t MAX_SPARE_FRAMES = 256;
     /** String stream for output formatting. */
     mutable std::ostringstream oss;
+    /** Native code for hot functions and loops. */
+    std::unique_ptr<Jit> jit;
+    /** Linear traces for hot loops the JIT does not compile. */
+    std::unique_ptr<LoopTracer> tracer;
+    /** The value of the 'return' being executed, until its call takes it. */
+    lox_literal returnValue;
+    /** Set by a 'return' statement, so blocks and loops stop; cleared by takeReturnValue. */
+    bool returning = false;
+    /** Set by a tail call until the call it returns from runs it. */
+    TailCall pendingTailCall;
+    /** Calls running, tail calls made in place excepted. */
+    size_t callDepth = 0;
+    size_t maxCallDepth = CallStack::DEFAULT_MAX_DEPTH;
 };
\ No newline at end of file
@@ -1,15 +1,5 @@
 #pragma once
-#include <variant>
-#include <string>
-#include <memory>
+#include "Value.hpp"
 
-class LoxCallable; // Forward declaration only
-class LoxInstance; // Forward declaration for use in lox_literal
-using lox_literal = std::variant<
-    std::monostate, 
-    double, 
-    std::string, 
-    bool, 
-    std::shared_ptr<LoxCallable>,
-    std::shared_ptr<LoxInstance>
->;
+/** Every Lox value, from token literals to runtime values, is a NaN-boxed Value. */
+using lox_literal = Value;
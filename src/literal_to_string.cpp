@@ -5,31 +5,26 @@
 #include "LoxInstance.hpp"
 #include <cstdint>
 
-std::string literal_to_string(const lox_literal& value) {
-    if (std::holds_alternative<std::monostate>(value)) return "nil";
-    if (std::holds_alternative<std::string>(value)) return std::get<std::string>(value);
-    if (std::holds_alternative<double>(value)) {
-        double d = std::get<double>(value);
-        if (d == static_cast<int64_t>(d)) {
-            return std::to_string(static_cast<int64_t>(d));
-        } else {
-            std::ostringstream oss;
-            oss << std::fixed << std::setprecision(6) << d;
-            std::string s = oss.str();
-            // Remove trailing zeros and decimal point if not needed
-            s.erase(s.find_last_not_of('0') + 1, std::string::npos);
-            if (!s.empty() && s.back() == '.') s.pop_back();
-            return s;
-        }
-    }
-    if (std::holds_alternative<bool>(value)) return std::get<bool>(value) ? "true" : "false";
-    if (std::holds_alternative<std::shared_ptr<LoxCallable>>(value)) {
-        auto fn = std::get<std::shared_ptr<LoxCallable>>(value);
-        return fn ? fn->toString() : "<fn>";
-    }
-    if (std::holds_alternative<std::shared_ptr<LoxInstance>>(value)) {
-        auto inst = std::get<std::shared_ptr<LoxInstance>>(value);
-        return inst ? inst->toString() : "<instance>";
+std::string number_to_string(double d) {
+    if (d == static_cast<int64_t>(d)) {
+        return std::to_string(static_cast<int64_t>(d));
     }
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(6) << d;
+    std::string s = oss.str();
+    // Remove trailing zeros and decimal point if not needed
+    s.erase(s.find_last_not_of('0') + 1, std::string::npos);
+    if (!s.empty() && s.back() == '.') s.pop_back();
+    return s;
+}
+
+std::string literal_to_string(const lox_literal& value) {
+    if (value.isNil()) return "nil";
+    if (value.isString()) return std::string(value.asString());
+    if (value.isInt()) return std::to_string(value.asInt());
+    if (value.isNumber()) return number_to_string(value.asNumber());
+    if (value.isBool()) return value.asBool() ? "true" : "false";
+    if (value.isCallable()) return value.asCallable()->toString();
+    if (value.isInstance()) return value.asInstance()->toString();
     return "";
 }
\ No newline at end of file
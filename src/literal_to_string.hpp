@@ -3,3 +3,6 @@
 #include "literal.hpp"
 
 std::string literal_to_string(const lox_literal& value);
+
+/** Format a number the way Lox prints it (integers without a fractional part). */
+std::string number_to_string(double d);
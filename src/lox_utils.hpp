@@ -5,14 +5,14 @@
 #include <stdexcept>
 
 inline bool isTruthy(const lox_literal& value) {
-    if (std::holds_alternative<std::monostate>(value)) return false;
-    if (std::holds_alternative<bool>(value)) return std::get<bool>(value);
+    if (value.isNil()) return false;
+    if (value.isBool()) return value.asBool();
     return true;
 }
 
 inline void checkNumberOperand(const Token& op, const std::vector<lox_literal>& operands) {
     for (const auto& operand : operands) {
-        if (!std::holds_alternative<double>(operand)) {
+        if (!operand.isNumber()) {
             throw RuntimeError(op, "Operand must be a number.");
         }
     }
@@ -9,15 +9,33 @@
 #include "RuntimeError.hpp"
 #include "literal.hpp"
 #include "Resolver.hpp"
+#include "VM.hpp"
+#include "ClosureCompiler.hpp"
+#include "AotCompiler.hpp"
+#include "CallStack.hpp"
+#include "SourceFile.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <unistd.h>
 
-std::string read_file_contents(const std::string& filename);
+int build_executable(const std::string& source, const std::string& output);
+
+/** Prints the Heap's per-kind byte counts and the collector's statistics to stderr on the way out of a run, if enabled. */
+struct HeapReport {
+    bool enabled;
+    ~HeapReport() {
+        if (!enabled) return;
+        Heap::report(std::cerr);
+        Gc::report(std::cerr);
+    }
+};
 
 /**
  * Execute a Lox program by resolving variable scopes and then interpreting.
  */
 void interpret(std::vector<std::shared_ptr<Stmt>>& statements){
     Interpreter interpreter;
-    Resolver resolver(interpreter);
+    Resolver resolver;
     resolver.resolve(statements);
     for(const auto& statement : statements){
         interpreter.execute(*statement);
@@ -34,13 +52,67 @@ int main(int argc, char *argv[]) {
 
     try {
         if (argc < 3) {
-            std::cerr << "Usage: ./your_program <command> <filename>" << std::endl;
-            std::cerr << "Commands: tokenize, parse, evaluate, run" << std::endl;
+            std::cerr << "Usage: ./your_program <command> [options] <filename>" << std::endl;
+            std::cerr << "       ./your_program compile <filename> -o <executable>" << std::endl;
+            std::cerr << "Commands: tokenize, parse, evaluate, run, vm, compile" << std::endl;
+            std::cerr << "Options for run: --engine=tree|closure|vm, --no-jit, --no-trace, --heap-stats, --max-depth=N" << std::endl;
             return 1;
         }
 
-        const std::string command = argv[1];
-        std::string file_contents = read_file_contents(argv[2]);
+        std::string command = argv[1];
+        std::string engine = "tree";
+        bool useJit = true;
+        bool useTracer = true;
+        bool heapStats = false;
+        size_t maxDepth = CallStack::DEFAULT_MAX_DEPTH;
+        int fileArg = 2;
+        while (fileArg < argc - 1 && std::strncmp(argv[fileArg], "--", 2) == 0) {
+            const std::string option = argv[fileArg++];
+            if (option.rfind("--engine=", 0) == 0) {
+                engine = option.substr(std::strlen("--engine="));
+            } else if (option == "--no-jit") {
+                useJit = false;
+            } else if (option == "--no-trace") {
+                useTracer = false;
+            } else if (option == "--heap-stats") {
+                heapStats = true;
+            } else if (option.rfind("--max-depth=", 0) == 0) {
+                const char* digits = option.c_str() + std::strlen("--max-depth=");
+                char* end = nullptr;
+                maxDepth = std::strtoul(digits, &end, 10);
+                if (*digits == '\0' || *end != '\0' || maxDepth == 0 || maxDepth > CallStack::MAX_DEPTH) {
+                    std::cerr << "Invalid maximum depth: " << digits << std::endl;
+                    return 1;
+                }
+            } else {
+                std::cerr << "Unknown option: " << option << std::endl;
+                return 1;
+            }
+        }
+        if (command == "vm") {
+            // Shorthand for 'run --engine=vm'
+            command = "run";
+            engine = "vm";
+        }
+        if (engine != "tree" && engine != "closure" && engine != "vm") {
+            std::cerr << "Unknown engine: " << engine << std::endl;
+            return 1;
+        }
+        std::string output;
+        if (command == "compile") {
+            if (fileArg + 2 >= argc || std::strcmp(argv[fileArg + 1], "-o") != 0) {
+                std::cerr << "Usage: ./your_program compile <filename> -o <executable>" << std::endl;
+                return 1;
+            }
+            output = argv[fileArg + 2];
+        }
+        // Tokens and the AST view their names in the source, so it stays mapped until the program exits
+        SourceFile source(argv[fileArg]);
+        if (!source.isOpen()) {
+            std::cerr << "Error reading file: " << argv[fileArg] << std::endl;
+            std::exit(1);
+        }
+        std::string_view file_contents = source.text();
 
         if (command == "tokenize") {
             // Tokenize the source and print tokens
@@ -81,49 +153,101 @@ int main(int argc, char *argv[]) {
                 return 65;
             }
         } else if(command == "run"){
-            // Run a complete Lox program
-            try{
-                Tokenizer tokenizer(file_contents, false);
-                std::vector<Token> tokens = tokenizer.tokenize();
-                Parser parser(tokens);
-                std::vector<std::shared_ptr<Stmt>> statements = parser.parse();
-                if (!statements.empty()) {
-                    try {
-                        Interpreter interpreter;
-                        Resolver resolver(interpreter);
-                        
-                        // Phase 1: Resolve variable scopes (compile-time)
+            // Run a complete Lox program, on a stack with room for maxDepth calls
+            int status = CallStack::run(maxDepth, [&]() -> int {
+                HeapReport heapReport{heapStats};
+                try{
+                    Tokenizer tokenizer(file_contents, false);
+                    std::vector<Token> tokens = tokenizer.tokenize();
+                    Parser parser(tokens);
+                    std::vector<std::shared_ptr<Stmt>> statements = parser.parse();
+                    if (!statements.empty()) {
                         try {
-                            resolver.resolve(statements);
+                            Interpreter interpreter;
+                            interpreter.setJitEnabled(useJit);
+                            interpreter.setTracingEnabled(useTracer);
+                            interpreter.setMaxCallDepth(maxDepth);
+                            Resolver resolver;
+                            std::unique_ptr<VM> vm;
+                            ObjFunction* script = nullptr;
+                            std::vector<CompiledStmt> program;
+                        
+                            // Phase 1: Resolve variable scopes (compile-time), then compile for the selected engine
+                            try {
+                                resolver.resolve(statements);
+                                if (engine == "vm") {
+                                    vm = std::make_unique<VM>();
+                                    vm->setMaxFrames(maxDepth);
+                                    script = vm->compile(statements);
+                                } else if (engine == "closure") {
+                                    ClosureCompiler compiler;
+                                    program = compiler.compile(statements);
+                                }
+                            } catch(const RuntimeError& e) {
+                                std::cerr << e.what() << "\n";
+                                std::cerr << e.token.getLine() << std::endl;
+                                return 65;
+                            }
+                        
+                            // Phase 2: Execute the program (runtime)
+                            if (vm) {
+                                vm->run(script);
+                            } else if (engine == "closure") {
+                                for(const auto& statement : program){
+                                    statement(interpreter);
+                                }
+                            } else {
+                                for(const auto& statement : statements){
+                                    interpreter.execute(*statement);
+                                }
+                            }
                         } catch(const RuntimeError& e) {
                             std::cerr << e.what() << "\n";
                             std::cerr << e.token.getLine() << std::endl;
-                            return 65;
+                            return 70;
                         }
-                        
-                        // Phase 2: Execute the program (runtime)
-                        for(const auto& statement : statements){
-                            interpreter.execute(*statement);
-                        }
-                    } catch(const RuntimeError& e) {
-                        std::cerr << e.what() << "\n";
-                        std::cerr << e.token.getLine() << std::endl;
-                        return 70;
+                    } else {
+                        std::cerr << "Executing failed." << std::endl;
+                        return 65;
                     }
-                } else {
-                    std::cerr << "Executing failed." << std::endl;
+                }catch(const Parser::ParseError& e){
+                    std::cerr << e.what() << std::endl;
+                    return 65;
+                }catch(const std::exception& e){
+                    std::cerr << e.what() << std::endl;
+                    return 65;
+                }catch(...){
+                    std::cerr << "An unknown error occurred." << std::endl;
                     return 65;
                 }
-            }catch(const Parser::ParseError& e){
-                std::cerr << e.what() << std::endl;
+                return 0;
+            });
+            if (status != 0) return status;
+        } else if(command == "compile"){
+            // Translate a complete Lox program to C++ and build it into a native executable
+            std::string source;
+            try{
+                Tokenizer tokenizer(file_contents, false);
+                std::vector<Token> tokens = tokenizer.tokenize();
+                Parser parser(tokens);
+                std::vector<std::shared_ptr<Stmt>> statements = parser.parse();
+                if (statements.empty()) {
+                    std::cerr << "Compiling failed." << std::endl;
+                    return 65;
+                }
+                Resolver resolver;
+                resolver.resolve(statements);
+                AotCompiler compiler;
+                source = compiler.compile(statements);
+            }catch(const RuntimeError& e){
+                std::cerr << e.what() << "\n";
+                std::cerr << e.token.getLine() << std::endl;
                 return 65;
             }catch(const std::exception& e){
                 std::cerr << e.what() << std::endl;
                 return 65;
-            }catch(...){
-                std::cerr << "An unknown error occurred." << std::endl;
-                return 65;
             }
+            return build_executable(source, output);
         } else {
             std::cerr << "Unknown command: " << command << std::endl;
             return 1;
@@ -139,18 +263,33 @@ int main(int argc, char *argv[]) {
 }
 
 /**
- * Read the entire contents of a file into a string.
+ * Compile generated C++ against the loxrt runtime library with the same
+ * compiler and flags the interpreter was built with. Returns an exit code.
  */
-std::string read_file_contents(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error reading file: " << filename << std::endl;
-        std::exit(1);
+int build_executable(const std::string& source, const std::string& output) {
+    namespace fs = std::filesystem;
+    fs::path sourcePath = fs::temp_directory_path() / ("lox-aot-" + std::to_string(getpid()) + ".cpp");
+    {
+        std::ofstream file(sourcePath);
+        if (!file) {
+            std::cerr << "Error writing file: " << sourcePath.string() << std::endl;
+            return 1;
+        }
+        file << source;
     }
 
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    file.close();
-
-    return buffer.str();
+    const char* compiler = std::getenv("CXX");
+    std::string command = std::string("'") + (compiler && *compiler ? compiler : LOX_CXX_COMPILER) + "'"
+        + " -std=c++23 -O2 " LOX_CXX_FLAGS
+        + " -I'" LOX_RUNTIME_INCLUDE_DIR "'"
+        + " '" + sourcePath.string() + "'"
+        + " '" LOX_RUNTIME_LIBRARY "'"
+        + " -o '" + output + "'";
+    int status = std::system(command.c_str());
+    fs::remove(sourcePath);
+    if (status != 0) {
+        std::cerr << "Building " << output << " failed." << std::endl;
+        return 1;
+    }
+    return 0;
 }
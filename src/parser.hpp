@@ -3,6 +3,7 @@
 #include "tokenizer.hpp"
 #include "Expr.hpp"
 #include "Stmt.hpp"
+#include "Heap.hpp"
 #include <iostream>
 #include <vector>
 #include <unordered_map>
@@ -52,7 +53,7 @@ private:
         if (match({TokenType::PRINT})) return printStatement();
         if (match({TokenType::RETURN})) return returnStatement();
         if (match({TokenType::WHILE})) return whileStatement();
-        if (match({TokenType::LEFT_BRACE})) return std::make_shared<Block>(block());
+        if (match({TokenType::LEFT_BRACE})) return Heap::make<Block>(block());
         return expressionStatement();
     }
 
@@ -77,7 +78,7 @@ private:
         std::optional<std::shared_ptr<Expr>> superclass = std::nullopt;
         if(match({TokenType::LESS})){
             try_consume(TokenType::IDENTIFIER, "Expect superclass name.");
-            superclass = std::make_shared<Variable>(previous());
+            superclass = Heap::make<Variable>(previous());
         }
         try_consume(TokenType::LEFT_BRACE, "Expect '{' before class body.");
 
@@ -86,7 +87,7 @@ private:
             methods.push_back(function("method"));
         }
         try_consume(TokenType::RIGHT_BRACE, "Expect '}' after class body.");
-        return std::make_shared<Class>(name, superclass, methods);
+        return Heap::make<Class>(name, superclass, methods);
     }
 
     std::shared_ptr<Function> function(const std::string& kind){
@@ -106,7 +107,7 @@ private:
         try_consume(TokenType::RIGHT_PAREN, "Expect ')' after parameters.");
         try_consume(TokenType::LEFT_BRACE, "Expect '{' before " + kind + " body.");
         std::vector<std::shared_ptr<Stmt>> body = block();
-        return std::make_shared<Function>(name, params, std::make_shared<Block>(body));
+        return Heap::make<Function>(name, params, Heap::make<Block>(body));
     }
 
     std::shared_ptr<Stmt> varDeclaration(){
@@ -120,9 +121,9 @@ private:
         }
         try_consume(TokenType::SEMICOLON, "Expect ';' after variable declaration.");
         if(!initializer) {
-            initializer = std::make_shared<Literal>(std::monostate{});
+            initializer = Heap::make<Literal>(std::monostate{});
         }
-        return std::make_shared<Var>(name, initializer.value());
+        return Heap::make<Var>(name, initializer.value());
     }
 
     std::shared_ptr<Stmt> forStatement(){
@@ -169,23 +170,23 @@ private:
         if(increment) {
             std::vector<std::shared_ptr<Stmt>> bodyStmts;
             bodyStmts.push_back(body);
-            bodyStmts.push_back(std::make_shared<Expression>(increment));
-            body = std::make_shared<Block>(bodyStmts);
+            bodyStmts.push_back(Heap::make<Expression>(increment));
+            body = Heap::make<Block>(bodyStmts);
         }
 
         // Condition defaults to true if omitted
         if(!condition) {
-            condition = std::make_shared<Literal>(true);
+            condition = Heap::make<Literal>(true);
         }
 
-        auto whileStmt = std::make_shared<While>(condition, body);
+        auto whileStmt = Heap::make<While>(condition, body);
 
         // If initializer exists, wrap in a block
         if(initializer) {
             std::vector<std::shared_ptr<Stmt>> stmts;
             stmts.push_back(initializer);
             stmts.push_back(whileStmt);
-            return std::make_shared<Block>(stmts);
+            return Heap::make<Block>(stmts);
         } else {
             return whileStmt;
         }
@@ -203,7 +204,7 @@ private:
         if(!bodyOpt) {
             throw error(peek(), "Expect statement after 'while' condition.");
         }
-        return std::make_shared<While>(condition.value(), bodyOpt);
+        return Heap::make<While>(condition.value(), bodyOpt);
     }
 
     std::shared_ptr<Stmt> ifStatement(){
@@ -225,7 +226,7 @@ private:
             }
             elseBranch = elseOpt;
         }
-        return std::make_shared<If>(condition.value(), thenBranch, elseBranch);
+        return Heap::make<If>(condition.value(), thenBranch, elseBranch);
     }
 
     std::shared_ptr<Stmt> returnStatement(){
@@ -240,7 +241,7 @@ private:
         }
 
         try_consume(TokenType::SEMICOLON, "Expect ';' after return value.");
-        return std::make_shared<Return>(keyword, value);
+        return Heap::make<Return>(keyword, value);
     }
 
     std::vector<std::shared_ptr<Stmt>> block(){
@@ -260,14 +261,14 @@ private:
         auto value = expression();
         try_consume(TokenType::SEMICOLON,"Expect ';' after value.");
         if(!value) return nullptr;
-        return std::make_shared<Print>(value.value());
+        return Heap::make<Print>(value.value());
     }
 
     std::shared_ptr<Stmt> expressionStatement(){
         auto expr = expression();
         try_consume(TokenType::SEMICOLON,"Expect ';' after expression.");
         if(!expr) return nullptr;
-        return std::make_shared<Expression>(expr.value());
+        return Heap::make<Expression>(expr.value());
     }
 
     void synchronize(){
@@ -304,9 +305,9 @@ private:
 
             if(auto varExpr = dynamic_cast<Variable*>(expr->get())){
                 Token name = varExpr->name;
-                return std::make_shared<Assign>(name, value.value());
+                return Heap::make<Assign>(name, value.value());
             }else if(auto getExpr = dynamic_cast<Get*>(expr->get())){
-                return std::make_shared<Set>(getExpr->object, getExpr->name, value.value());
+                return Heap::make<Set>(getExpr->object, getExpr->name, value.value());
             }
 
             throw error(equals, "Invalid assignment target.");
@@ -322,7 +323,7 @@ private:
             Token op = previous();
             std::optional<std::shared_ptr<Expr>> right = andExpr();
             if(!right) return std::nullopt;
-            expr = std::make_shared<Logical>(expr.value(), op, right.value());
+            expr = Heap::make<Logical>(expr.value(), op, right.value());
         }
         return expr;
     }
@@ -335,7 +336,7 @@ private:
             Token op = previous();
             std::optional<std::shared_ptr<Expr>> right = equality();
             if(!right) return std::nullopt;
-            expr = std::make_shared<Logical>(expr.value(), op, right.value());
+            expr = Heap::make<Logical>(expr.value(), op, right.value());
         }
         return expr;
     }
@@ -347,7 +348,7 @@ private:
             Token op = previous();
             std::optional<std::shared_ptr<Expr>> right = comparison();
             if(!right) return std::nullopt;
-            expr = std::make_shared<Binary>(expr.value(), op, right.value());
+            expr = Heap::make<Binary>(expr.value(), op, right.value());
         }
         return expr;
     }
@@ -359,7 +360,7 @@ private:
             Token op = previous();
             std::optional<std::shared_ptr<Expr>> right = term();
             if(!right) return std::nullopt;
-            expr = std::make_shared<Binary>(expr.value(),op,right.value());
+            expr = Heap::make<Binary>(expr.value(),op,right.value());
         }
         return expr;
     }
@@ -371,7 +372,7 @@ private:
             Token op = previous();
             std::optional<std::shared_ptr<Expr>> right = factor();
             if(!right) return std::nullopt;
-            expr = std::make_shared<Binary>(expr.value(), op, right.value());
+            expr = Heap::make<Binary>(expr.value(), op, right.value());
         }
         return expr;
     }
@@ -383,7 +384,7 @@ private:
             Token op = previous();
             std::optional<std::shared_ptr<Expr>> right = unary();
             if(!right) return std::nullopt;
-            expr = std::make_shared<Binary>(expr.value(), op, right.value());
+            expr = Heap::make<Binary>(expr.value(), op, right.value());
         }
         return expr;
     }
@@ -393,7 +394,7 @@ private:
             Token op = previous();
             std::optional<std::shared_ptr<Expr>> right = unary();
             if(!right) return std::nullopt;
-            return std::make_shared<Unary>(op, right.value());
+            return Heap::make<Unary>(op, right.value());
         }
         return call();
     }
@@ -407,7 +408,7 @@ private:
                 expr = finishCall(expr.value());
             }else if(match({TokenType::DOT})){
                 Token name = try_consume(TokenType::IDENTIFIER, "Expect property name after '.'.");
-                expr = std::make_shared<Get>(expr.value(), name);
+                expr = Heap::make<Get>(expr.value(), name);
             }else{
                 break;
             }
@@ -431,21 +432,21 @@ private:
 
         Token paren = try_consume(TokenType::RIGHT_PAREN, "Expect ')' after arguments.");
 
-        return std::make_shared<Call>(callee, paren, std::move(arguments));
+        return Heap::make<Call>(callee, paren, std::move(arguments));
     }
 
     std::optional<std::shared_ptr<Expr>> primary(){
         if(match({TokenType::TRUE})){
-            return std::make_shared<Literal>(true);
+            return Heap::make<Literal>(true);
         }
         if(match({TokenType::FALSE})){
-            return std::make_shared<Literal>(false);
+            return Heap::make<Literal>(false);
         }
         if(match({TokenType::NIL})){
-            return std::make_shared<Literal>(std::monostate{});
+            return Heap::make<Literal>(std::monostate{});
         }
         if(match({TokenType::NUMBER, TokenType::STRING})){
-            return std::make_shared<Literal>(previous().getLiteral());
+            return Heap::make<Literal>(previous().getLiteral());
         }
         if(match({TokenType::LEFT_PAREN})){
             std::optional<std::shared_ptr<Expr>> expr = expression();
@@ -453,21 +454,21 @@ private:
             if(!expr){
                 return std::nullopt;
             }
-            return std::make_shared<Grouping>(expr.value());
+            return Heap::make<Grouping>(expr.value());
         }
         if(match({TokenType::THIS})){
-            return std::make_shared<This>(previous());
+            return Heap::make<This>(previous());
         } 
         if(match({TokenType::SUPER})){
             Token keyword = previous();
             try_consume(TokenType::DOT, "Expect '.' after 'super'.");
             Token method = try_consume(TokenType::IDENTIFIER, "Expect superclass method name.");
-            return std::make_shared<Super>(keyword, method);
+            return Heap::make<Super>(keyword, method);
         }
         if(match({TokenType::IDENTIFIER})){
-            return std::make_shared<Variable>(previous());
+            return Heap::make<Variable>(previous());
         }else{
-            std::string lexme = peek().getLexeme();
+            std::string lexme(peek().getLexeme());
             if (lexme.empty()) lexme = "unknown";
             throw error(peek(), "Unexpected token: '" + lexme + "'. Expected an expression.");
         }
@@ -505,7 +506,7 @@ private:
         if (token.getTokenType() == TokenType::END_OF_FILE) {
             return ParseError("[line " + std::to_string(token.getLine()) + "] Error at end: " + message);
         } else {
-            return ParseError("[line " + std::to_string(token.getLine()) + "] Error at '" + token.getLexeme() + "': " + message);
+            return ParseError("[line " + std::to_string(token.getLine()) + "] Error at '" + std::string(token.getLexeme()) + "': " + message);
         }
     }
 
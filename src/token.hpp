@@ -1,6 +1,9 @@
 #pragma once
 #include <optional>
+#include <string>
+#include <string_view>
 #include "literal.hpp"
+#include "Symbol.hpp"
 
 enum class TokenType {
     LEFT_PAREN, RIGHT_PAREN, LEFT_BRACE, RIGHT_BRACE, COMMA, DOT, MINUS, PLUS, SEMICOLON, SLASH, STAR,
@@ -9,14 +12,25 @@ enum class TokenType {
     AND, CLASS, ELSE, FALSE, FUN, FOR, IF, NIL, OR, PRINT, RETURN, SUPER, THIS, TRUE, VAR, WHILE, END_OF_FILE
 };
 
+/**
+ * A token of Lox source. The lexeme is a view, not a copy: into the
+ * SourceFile for scanned tokens, or a string literal for made-up ones.
+ */
 class Token {
 public:
-    Token(TokenType type, std::string lexeme, lox_literal lit, int line)
-        : type(type), lexeme(std::move(lexeme)), lit(std::move(lit)), line(line) {}
+    Token(TokenType type, std::string_view lexeme, lox_literal lit, int line)
+        : type(type), lexeme(lexeme), lit(std::move(lit)), line(line) {
+        // Names are interned once here so every later lookup can key on the id
+        if (type == TokenType::IDENTIFIER || type == TokenType::THIS || type == TokenType::SUPER) {
+            symbol = SymbolTable::intern(this->lexeme);
+        }
+    }
 
     int getLength() const { return static_cast<int>(lexeme.length()); }
-    std::string getLexeme() const { return lexeme; }
-    std::string getLexmeWithType() const { return getStringType() + " " + lexeme; }
+    std::string_view getLexeme() const { return lexeme; }
+    /** Interned name of an identifier, 'this' or 'super' token. */
+    SymbolId getSymbol() const { return symbol; }
+    std::string getLexmeWithType() const { return getStringType() + " " + std::string(lexeme); }
     lox_literal getLiteral() const { return lit; }
     TokenType getTokenType() const { return type; }
     int getLine() const { return line; }
@@ -67,7 +81,8 @@ public:
 
 private:
     TokenType type;
-    std::string lexeme;
+    std::string_view lexeme;
     lox_literal lit;
     int line;
+    SymbolId symbol = 0;
 };
\ No newline at end of file
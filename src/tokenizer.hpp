@@ -4,29 +4,36 @@
 #include<fstream>
 #include "token.hpp"
 #include "literal.hpp"
+#include<charconv>
 #include<iomanip>
+#include<string_view>
 #include<vector>
 #include<map>
 
+/**
+ * Splits Lox source into tokens. Lexemes are views into the source text,
+ * which must outlive the tokens (see SourceFile), and number and string
+ * values are decoded from it in place, so scanning allocates nothing per
+ * token beyond string literal values.
+ */
 class Tokenizer{
 public:
-    Tokenizer(const std::string& input, bool printToken = false) : text(input), printToken(printToken) {}
+    Tokenizer(std::string_view input, bool printToken = false) : printToken(printToken), text(input) {}
 
     std::vector<Token> tokenize(){
         bool hitDef=false;
-        std::string buff="";
         tokens.clear();
         while(current<text.length()){
             char currentChar = peek();
             char currentToken;
             switch (currentChar){
-                case '"':
+                case '"': {
                     consume();
                     while(peek()!='"' && !isAtEnd()){
                         if(peek()=='\n'){
                             line++;
                         }
-                        buff+=consume();
+                        consume();
                     }
                     if(isAtEnd()){
                         std::cerr<<"[line "<<line<<"] Error: Unterminated string."<<std::endl;
@@ -34,10 +41,11 @@ public:
                         break;
                     }
                     consume();
-                    addToken(TokenType::STRING, buff);
-                    if(printToken) std::cout<<"STRING \""<<buff<<"\" "<<buff<<std::endl;
-                    buff="";
+                    std::string_view value = text.substr(start + 1, current - start - 2);
+                    addToken(TokenType::STRING, stringLiteral(value));
+                    if(printToken) std::cout<<"STRING \""<<value<<"\" "<<value<<std::endl;
                     break;
+                }
                 case '(':
                     currentToken = consume();
                     addToken(TokenType::LEFT_PAREN);
@@ -100,58 +108,46 @@ public:
                 case '!':
                     currentToken = consume();
                     if(peek()=='='){
-                        buff="";
-                        buff+=currentToken;
-                        buff+=consume();
+                        consume();
                         addToken(TokenType::BANG_EQUAL);
-                        if(printToken) std::cout<<"BANG_EQUAL "<<buff<<" null"<<std::endl;
+                        if(printToken) std::cout<<"BANG_EQUAL "<<lexeme()<<" null"<<std::endl;
                     }else{
                         addToken(TokenType::BANG);
                         if(printToken) std::cout<<"BANG "<<currentToken<<" null"<<std::endl;
                     }
-                    buff="";
                     break;
                 case '=':
                     currentToken = consume();
                     if(peek()=='='){
-                        buff="";
-                        buff+=currentToken;
-                        buff+=consume();
+                        consume();
                         addToken(TokenType::EQUAL_EQUAL);
-                        if(printToken) std::cout<<"EQUAL_EQUAL "<<buff<<" null"<<std::endl;
+                        if(printToken) std::cout<<"EQUAL_EQUAL "<<lexeme()<<" null"<<std::endl;
                     }else{
                         addToken(TokenType::EQUAL);
                         if(printToken) std::cout<<"EQUAL "<<currentToken<<" null"<<std::endl;
                     }
-                    buff="";
                     break;
                 case '<':
                     currentToken = consume();
                     if(peek()=='='){
-                        buff="";
-                        buff+=currentToken;
-                        buff+=consume();
+                        consume();
                         addToken(TokenType::LESS_EQUAL);
-                        if(printToken) std::cout<<"LESS_EQUAL "<<buff<<" null"<<std::endl;
+                        if(printToken) std::cout<<"LESS_EQUAL "<<lexeme()<<" null"<<std::endl;
                     }else{
                         addToken(TokenType::LESS);
                         if(printToken) std::cout<<"LESS "<<currentToken<<" null"<<std::endl;
                     }
-                    buff="";
                     break;
                 case '>':
                     currentToken = consume();
                     if(peek()=='='){
-                        buff="";
-                        buff+=currentToken;
-                        buff+=consume();
+                        consume();
                         addToken(TokenType::GREATER_EQUAL);
-                        if(printToken) std::cout<<"GREATER_EQUAL "<<buff<<" null"<<std::endl;
+                        if(printToken) std::cout<<"GREATER_EQUAL "<<lexeme()<<" null"<<std::endl;
                     }else{
                         addToken(TokenType::GREATER);
                         if(printToken) std::cout<<"GREATER "<<currentToken<<" null"<<std::endl;
                     }
-                    buff="";
                     break;
                 case ' ':
                 case '\r':
@@ -189,7 +185,8 @@ public:
     }
 private:
     bool printToken = false;
-    char peek(int index=0){
+    std::map<std::string_view, lox_literal> stringLiterals;
+    char peek(size_t index=0){
         if(current + index >= text.length()){
             return '\0';
         }
@@ -201,18 +198,29 @@ private:
     void addToken(TokenType type){
         addToken(type, lox_literal());
     }
+    /** Equal string literals share one LoxString, kept alive by the tokens and the AST. */
+    lox_literal stringLiteral(std::string_view text) {
+        auto it = stringLiterals.find(text);
+        if (it == stringLiterals.end()) {
+            it = stringLiterals.emplace(text, lox_literal(text)).first;
+        }
+        return it->second;
+    }
     void addToken(TokenType type, lox_literal lit) {
-        std::string lexeme = text.substr(start, current - start);
-        tokens.push_back(Token(type,lexeme,lit,line));
+        tokens.push_back(Token(type,lexeme(),lit,line));
+    }
+    /** The text of the token being scanned. */
+    std::string_view lexeme() const {
+        return text.substr(start, current - start);
     }
     bool isDigit(char c){
         return c>='0' && c<='9';
     }
-    std::string normalizeNumberLiteral(const std::string& numStr) {
+    std::string normalizeNumberLiteral(std::string_view numStr) {
         size_t dotPos = numStr.find('.');
         if (dotPos == std::string::npos) {
             // No decimal point, add ".0"
-            return numStr + ".0";
+            return std::string(numStr) + ".0";
         }
         // Start from the end and remove trailing zeros
         size_t endPos = numStr.size() - 1;
@@ -223,40 +231,33 @@ private:
         if (endPos == dotPos) {
             endPos++;
         }
-        return numStr.substr(0, endPos + 1);
+        return std::string(numStr.substr(0, endPos + 1));
     }
     void identifier(){
-        std::string buff="";
-        std::string typeToPrint="";
         while(isalnum(peek()) || peek()=='_'){
-            buff+=consume();
+            consume();
         }
-        Token token = Token(TokenType::IDENTIFIER, buff, lox_literal(), line);
-        if(keywords.find(buff)!=keywords.end()){
-            TokenType type = keywords[buff];
-            token = Token(type, buff, lox_literal(), line);
-            typeToPrint = token.getStringType();
+        std::string_view name = lexeme();
+        TokenType type = TokenType::IDENTIFIER;
+        auto keyword = keywords.find(name);
+        if(keyword!=keywords.end()){
+            type = keyword->second;
         }
-        addToken(token.getTokenType(), token.getLiteral());
+        addToken(type);
         if(printToken){
-            if(typeToPrint.empty()){
-                typeToPrint = "IDENTIFIER";
-            }else{
-                typeToPrint = token.getStringType();
-            }
-            std::cout << typeToPrint << " " << buff << " null" << std::endl;
+            std::cout << tokens.back().getStringType() << " " << name << " null" << std::endl;
         }
     }
     void number() {
-        std::string buff = "";
+        size_t numberStart = current;
         bool isFloat = false;
         while (isDigit(peek())) {
-            buff += consume();
+            consume();
         }
+        std::string_view buff = text.substr(numberStart, current - numberStart);
         // Handle case like "123." (trailing dot but not float)
         if (peek() == '.' && !isDigit(peek(1))) {
-            double value = std::stod(buff);
-            addToken(TokenType::NUMBER, value);
+            addToken(TokenType::NUMBER, integerLiteral(buff));
             if(printToken){
                 std::cout << "NUMBER " << buff << " " << buff << ".0" << std::endl;
                 std::cout << "DOT . null" << std::endl;
@@ -267,31 +268,43 @@ private:
         // Handle float like "123.456"
         if (peek() == '.' && isDigit(peek(1))) {
             isFloat = true;
-            buff += consume(); // consume the dot
+            consume(); // consume the dot
             while (isDigit(peek())) {
-                buff += consume();
+                consume();
             }
+            buff = text.substr(numberStart, current - numberStart);
         }
         if (isFloat) {
-            std::string normalized = normalizeNumberLiteral(buff);
-            addToken(TokenType::NUMBER, std::stod(normalized));
-            if(printToken) std::cout << "NUMBER " << buff << " " << normalized << std::endl;
+            addToken(TokenType::NUMBER, decimal(buff));
+            if(printToken) std::cout << "NUMBER " << buff << " " << normalizeNumberLiteral(buff) << std::endl;
         }else {
-            std::string normalized = buff+".0";
-            addToken(TokenType::NUMBER, std::stod(normalized));
-            if(printToken) std::cout << "NUMBER " << buff << " " << normalized << std::endl;
+            addToken(TokenType::NUMBER, integerLiteral(buff));
+            if(printToken) std::cout << "NUMBER " << buff << " " << buff << ".0" << std::endl;
+        }
+    }
+    /** A literal with no fractional part becomes an integer Value when it fits one. */
+    lox_literal integerLiteral(std::string_view digits) {
+        if (digits.size() <= 15) {
+            long long value = 0;
+            std::from_chars(digits.data(), digits.data() + digits.size(), value);
+            return lox_literal::integer(value);
         }
+        return decimal(digits);
+    }
+    static double decimal(std::string_view digits) {
+        double value = 0;
+        std::from_chars(digits.data(), digits.data() + digits.size(), value);
+        return value;
     }
     bool isAtEnd(){
         return current>=text.length();
     }
-    int start=0;
-    int current=0;
+    size_t start=0;
+    size_t current=0;
     int line=1;
-    std::string text;
-    std::string current_token;
+    std::string_view text;
     std::vector<Token> tokens;
-    std::map<std::string,TokenType> keywords = {
+    std::map<std::string_view,TokenType> keywords = {
         {"and", TokenType::AND},
         {"class", TokenType::CLASS},
         {"else", TokenType::ELSE},